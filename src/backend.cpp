@@ -0,0 +1,321 @@
+#include "backend.h"
+
+namespace {
+
+/* Initial cost models, calibrated while files are inflated */
+const double CARD_LATENCY = 2e-3;  //Buffer reset, state and history migrations, output read back
+const double CARD_RATE    = 400e6;
+const double HOST_LATENCY = 2e-5;
+const double HOST_RATE    = 100e6;
+
+/* Files of fewer uncompressed bytes measure the latency of a unit, larger ones its throughput */
+const double SMALL_FILE = 64 << 10;
+
+/* Weight of a new measurement in a cost model */
+const double CALIBRATION_WEIGHT = 0.2;
+
+/* Inflates a deflate stream that fits into one input window and one
+   output chunk in a single run on the host, without the threads of
+   the buffer pipeline. Returns false, with nothing written, if the run
+   did not reach the end of the stream. */
+bool inflate_once(inf::cu_buffers &cu, FILE *fin, long offset, uint64_t length, FILE *fout, bool to_stdout,
+                  unsigned int &crc, unsigned int &isize, size_t &output_total, inf::pipeline_stats &stats, int &err)
+{
+	inf::pipeline_slot &s = cu.slots[0];
+	unsigned char *source = s.source.data();
+
+	//The kernel code reads a regular file straight from its mapping, all others are read into the input window
+	double start = omp_get_wtime();
+	inf::mapped_file map(fin, offset, length);
+	const unsigned char *window = map.window(0, length);
+	bool ok = window != NULL;
+	if(ok) source = const_cast<unsigned char *>(window);
+	else
+	{
+		fseek(fin, offset, SEEK_SET);
+		ok = fread(source, 1, length, fin) == length;
+	}
+	stats.read.seconds += omp_get_wtime() - start;
+	stats.read.bytes   += length;
+	if(!ok)
+	{
+		err = inf::TINF_FILE_ERROR;
+		return true;
+	}
+
+	start = omp_get_wtime();
+	fpga_uncompress(s.dest.data(), inf::OUTPUT_CHUNK, source, length, cu.state.data(), cu.history.data());
+	stats.kernel.seconds += omp_get_wtime() - start;
+	stats.kernel.bytes   += cu.state[0].src_used;
+
+	if(cu.state[0].err != inf::TINF_OK)
+	{
+		std::cerr << "decompression failed\n";
+		err = cu.state[0].err;
+		return true;
+	}
+	if(!cu.state[0].bfinal)
+	{
+		cu.reset();
+		return false;
+	}
+
+	start = omp_get_wtime();
+	inf::write_output(s.dest.data(), cu.state[0].dst_used, fout, to_stdout);
+	stats.write.seconds += omp_get_wtime() - start;
+	stats.write.bytes   += cu.state[0].dst_used;
+
+	output_total += cu.state[0].dst_used;
+	crc   = cu.history[0].crc;
+	isize = cu.history[0].isize;
+	err   = inf::TINF_OK;
+
+	return true;
+}
+
+/* True if the Xilinx platform has an accelerator card, prints nothing */
+bool accelerator_present()
+{
+#ifdef INF_LOCAL_STREAM
+	return true; //The simulated cards
+#else
+	std::vector<cl::Platform> platforms;
+	if(cl::Platform::get(&platforms) != CL_SUCCESS) return false;
+
+	for(size_t i = 0; i < platforms.size(); ++i)
+	{
+		if(platforms[i].getInfo<CL_PLATFORM_NAME>() != "Xilinx") continue;
+
+		std::vector<cl::Device> devices;
+		if(platforms[i].getDevices(CL_DEVICE_TYPE_ACCELERATOR, &devices) != CL_SUCCESS) return false;
+		return !devices.empty();
+	}
+	return false;
+#endif
+}
+
+} //namespace
+
+inf::opencl_backend::opencl_backend(const inf::options &opt, const std::string &kernel)
+  : registry(opt.binary, kernel, omp_get_max_threads(), opt.memory)
+{
+}
+
+inf::cu_buffers &inf::opencl_backend::buffers(unsigned int unit)
+{
+	return registry.device(unit).pool->acquire(registry.unit(unit));
+}
+
+int inf::opencl_backend::inflate(unsigned int unit, FILE *fin, const inf::gzip_member &member, FILE *fout, bool to_stdout,
+                                 size_t &output_total, inf::pipeline_stats &stats)
+{
+	//Buffers of the compute unit, reset for every file
+	return inf::inflate_member(buffers(unit), fin, member, fout, to_stdout, output_total, stats);
+}
+
+int inf::opencl_backend::verify(unsigned int unit, FILE *fin, const inf::gzip_member &member,
+                                unsigned int &crc, unsigned int &isize)
+{
+	//Buffers and kernel of the compute unit, reset for every file
+	return inf::verify_buffer(buffers(unit), fin, member.dist, member.srclen - member.dist - 8, crc, isize);
+}
+
+inf::cpu_backend::cpu_backend(unsigned int units, size_t budget)
+  : arenas(units)
+{
+	pairs = inf::buffer_pool::pairs_for(units, budget);
+}
+
+int inf::cpu_backend::inflate(unsigned int unit, FILE *fin, const inf::gzip_member &member, FILE *fout, bool to_stdout,
+                              size_t &output_total, inf::pipeline_stats &stats)
+{
+	unsigned int crc   = 0;
+	unsigned int isize = 0;
+
+	int err = run(unit, fin, member, fout, to_stdout, crc, isize, output_total, stats);
+
+	if((crc != member.crc || isize != member.isize) && err == inf::TINF_OK) err = inf::TINF_DATA_ERROR;
+
+	return err;
+}
+
+int inf::cpu_backend::verify(unsigned int unit, FILE *fin, const inf::gzip_member &member,
+                             unsigned int &crc, unsigned int &isize)
+{
+	//The verify kernel only saves the writes to the output, the host discards them instead
+	FILE *fout = fopen("/dev/null", "wb");
+	if(fout == NULL) return inf::TINF_FILE_ERROR;
+
+	size_t output_total = 0;
+	inf::pipeline_stats stats = inf::pipeline_stats();
+
+	int err = run(unit, fin, member, fout, false, crc, isize, output_total, stats);
+	fclose(fout);
+
+	return err;
+}
+
+int inf::cpu_backend::run(unsigned int unit, FILE *fin, const inf::gzip_member &member, FILE *fout, bool to_stdout,
+                          unsigned int &crc, unsigned int &isize, size_t &output_total, inf::pipeline_stats &stats)
+{
+	inf::cu_buffers &cu = acquire(unit);
+	uint64_t length = member.srclen - member.dist - 8;
+	int err = inf::TINF_OK;
+
+	//Small files in one run, all others through the buffer pipeline
+	if(length <= inf::INPUT_WINDOW && member.isize <= inf::OUTPUT_CHUNK &&
+	   inflate_once(cu, fin, member.dist, length, fout, to_stdout, crc, isize, output_total, stats, err)) return err;
+
+	return inf::inflate_buffer(cu, fin, member.dist, length, fout, to_stdout, crc, isize, output_total, stats);
+}
+
+inf::cu_buffers &inf::cpu_backend::acquire(unsigned int unit)
+{
+	std::unique_ptr<inf::cu_buffers> &cu = arenas[unit];
+
+	if(!cu) cu.reset(new inf::cu_buffers(pairs));
+	else    cu->reset();
+
+	return *cu;
+}
+
+inf::cost_model::cost_model(double latency, double rate)
+  : launch(latency), throughput(rate)
+{
+}
+
+double inf::cost_model::estimate(double bytes) const
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	return launch + bytes / throughput;
+}
+
+void inf::cost_model::add(double bytes, double seconds)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	if(bytes < SMALL_FILE)
+	{
+		double sample = seconds - bytes / throughput;
+		if(sample < 0) sample = 0;
+		launch += CALIBRATION_WEIGHT * (sample - launch);
+	}
+	else
+	{
+		double busy = seconds - launch;
+		if(busy < seconds * 0.1) busy = seconds * 0.1; //A run is never all latency
+		if(busy > 0) throughput += CALIBRATION_WEIGHT * (bytes / busy - throughput);
+	}
+}
+
+double inf::cost_model::latency() const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return launch;
+}
+
+double inf::cost_model::rate() const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return throughput;
+}
+
+inf::hybrid_backend::hybrid_backend(std::unique_ptr<inf::backend> cards, std::unique_ptr<inf::backend> host, bool verbose)
+  : cards(std::move(cards)), host(std::move(host)), verbose(verbose),
+    card_cost(CARD_LATENCY, CARD_RATE), host_cost(HOST_LATENCY, HOST_RATE)
+{
+}
+
+inf::hybrid_backend::~hybrid_backend()
+{
+	if(!verbose) return;
+
+	std::cerr << "cost model: " << cards->name() << " " << card_cost.latency() * 1e3 << " ms + " << card_cost.rate() * 1e-6 << " MB/s, "
+	          << host->name() << " " << host_cost.latency() * 1e3 << " ms + " << host_cost.rate() * 1e-6 << " MB/s\n";
+}
+
+double inf::hybrid_backend::estimate(unsigned int unit, long size, unsigned int isize) const
+{
+	//ISIZE is the length mod 2^32, the compressed size bounds it from below for most files
+	double bytes = isize;
+	if(size > bytes) bytes = size;
+
+	return model(unit).estimate(bytes);
+}
+
+inf::cu_buffers &inf::hybrid_backend::buffers(unsigned int unit)
+{
+	if(unit < cards->units()) return cards->buffers(unit);
+	else                      return host->buffers(unit - cards->units());
+}
+
+int inf::hybrid_backend::inflate(unsigned int unit, FILE *fin, const inf::gzip_member &member, FILE *fout, bool to_stdout,
+                                 size_t &output_total, inf::pipeline_stats &stats)
+{
+	double start = omp_get_wtime();
+	int err;
+
+	if(unit < cards->units()) err = cards->inflate(unit, fin, member, fout, to_stdout, output_total, stats);
+	else                      err = host->inflate(unit - cards->units(), fin, member, fout, to_stdout, output_total, stats);
+
+	if(err == inf::TINF_OK) model(unit).add(member.isize, omp_get_wtime() - start);
+
+	return err;
+}
+
+int inf::hybrid_backend::verify(unsigned int unit, FILE *fin, const inf::gzip_member &member,
+                                unsigned int &crc, unsigned int &isize)
+{
+	double start = omp_get_wtime();
+	int err;
+
+	if(unit < cards->units()) err = cards->verify(unit, fin, member, crc, isize);
+	else                      err = host->verify(unit - cards->units(), fin, member, crc, isize);
+
+	if(err == inf::TINF_OK) model(unit).add(member.isize, omp_get_wtime() - start);
+
+	return err;
+}
+
+inf::cost_model &inf::hybrid_backend::model(unsigned int unit) const
+{
+	return unit < cards->units() ? card_cost : host_cost;
+}
+
+std::unique_ptr<inf::backend> inf::open_backend(const inf::options &opt, const std::string &kernel)
+{
+	std::unique_ptr<inf::backend> engine;
+
+	if(opt.backend != "auto" && opt.backend != "fpga" && opt.backend != "cpu" && opt.backend != "hybrid")
+	{
+		std::cerr << "unknown backend '" << opt.backend << "'\n";
+		return engine;
+	}
+
+	//Cards if asked for or present, together with the threads of the host they leave, the host alone otherwise
+	if(opt.backend == "fpga" || opt.backend == "hybrid" || (opt.backend == "auto" && accelerator_present()))
+	{
+		std::unique_ptr<inf::opencl_backend> cards(new inf::opencl_backend(opt, kernel));
+		if(opt.backend == "fpga") return cards;
+
+		if(cards->units() > 0)
+		{
+			unsigned int threads = std::thread::hardware_concurrency();
+			threads = threads > cards->units() ? threads - cards->units() : 1;
+
+			//The memory budget is shared by the units of both sides
+			size_t card_budget = opt.memory / (cards->units() + threads) * cards->units();
+			cards->set_budget(card_budget);
+
+			std::unique_ptr<inf::backend> host(new inf::cpu_backend(threads, opt.memory - card_budget));
+			engine.reset(new inf::hybrid_backend(std::move(cards), std::move(host), opt.verbose));
+			return engine;
+		}
+	}
+
+	engine.reset(new inf::cpu_backend(omp_get_max_threads(), opt.memory));
+	if(opt.verbose) std::cerr << "running on " << engine->units() << " host threads\n";
+
+	return engine;
+}
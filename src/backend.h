@@ -0,0 +1,239 @@
+#ifndef BACKEND_H_INCLUDED
+#define BACKEND_H_INCLUDED
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "./tinf_data.h"
+
+namespace inf {
+
+/***************************************************************//**
+* \brief Run time of a file on a kind of unit: a fixed launch latency
+* plus the uncompressed size over the throughput.
+*
+* Starts from a guess and is calibrated by every run: small files
+* measure the latency, all others the throughput. All functions may
+* be called from any thread.
+********************************************************************/
+class cost_model
+{
+  public:
+    /***************************************************************//**
+    * @param latency initial launch latency in seconds
+    * @param rate initial throughput in uncompressed bytes per second
+    ********************************************************************/
+    cost_model(double latency, double rate);
+
+    /***************************************************************//**
+    * \brief Returns the estimated run time in seconds of a file with
+    * bytes uncompressed bytes
+    ********************************************************************/
+    double estimate(double bytes) const;
+
+    /***************************************************************//**
+    * \brief Adds a measured run of a file with bytes uncompressed bytes
+    ********************************************************************/
+    void add(double bytes, double seconds);
+
+    double latency() const; /**< current launch latency in seconds */
+    double rate() const;    /**< current throughput in bytes per second */
+
+  private:
+    mutable std::mutex lock;
+    double launch;
+    double throughput;
+};
+
+/***************************************************************//**
+* \brief Executes the inflate kernel on a number of units, e.g. the
+* compute units of the accelerator cards or threads of the host.
+*
+* A unit runs one file at a time; different units may be used from
+* different threads at the same time.
+********************************************************************/
+class backend
+{
+  public:
+    virtual ~backend() {}
+
+    /***************************************************************//**
+    * \brief Returns the name of the backend, as given to -B
+    ********************************************************************/
+    virtual const char *name() const = 0;
+
+    /***************************************************************//**
+    * \brief Returns the number of units, 0 if the backend is unusable
+    ********************************************************************/
+    virtual unsigned int units() const = 0;
+
+    /***************************************************************//**
+    * \brief Returns the estimated cost of a gzip file on a unit, see
+    * job_scheduler. All units of a plain backend are alike, so the
+    * cost is the compressed size.
+    *
+    * @param unit unit of the backend (counted from 0)
+    * @param size compressed size in bytes
+    * @param isize ISIZE of the footer
+    ********************************************************************/
+    virtual double estimate(unsigned int unit, long size, unsigned int isize) const
+    {
+      (void) unit;
+      (void) isize;
+      return size;
+    }
+
+    /***************************************************************//**
+    * \brief Returns the buffers of a unit, reset for a new stream,
+    * e.g. for a stream of unknown length, see uncompress_pipe
+    ********************************************************************/
+    virtual cu_buffers &buffers(unsigned int unit) = 0;
+
+    /***************************************************************//**
+    * \brief Inflates a gzip member on a unit, see inflate_member.
+    * Returns a tinf_error_code.
+    ********************************************************************/
+    virtual int inflate(unsigned int unit, FILE *fin, const gzip_member &member, FILE *fout, bool to_stdout,
+                        size_t &output_total, pipeline_stats &stats) = 0;
+
+    /***************************************************************//**
+    * \brief Inflates a gzip member on a unit without output and returns
+    * CRC and ISIZE of the output. Returns a tinf_error_code.
+    ********************************************************************/
+    virtual int verify(unsigned int unit, FILE *fin, const gzip_member &member,
+                       unsigned int &crc, unsigned int &isize) = 0;
+};
+
+/***************************************************************//**
+* \brief The compute units of all accelerator cards, over OpenCL.
+* In local builds (INF_LOCAL_STREAM) the cards are simulated.
+********************************************************************/
+class opencl_backend : public backend
+{
+  public:
+    /***************************************************************//**
+    * @param opt options, of which binary and memory are used
+    * @param kernel fpga_uncompress, or fpga_verify for verify
+    ********************************************************************/
+    opencl_backend(const options &opt, const std::string &kernel);
+
+    /***************************************************************//**
+    * \brief Sets the memory budget of the buffers of all units in
+    * bytes, before the units are used
+    ********************************************************************/
+    void set_budget(size_t budget) { registry.set_budget(budget); }
+
+    const char *name() const { return "fpga"; }
+    unsigned int units() const { return registry.workers(); }
+    cu_buffers &buffers(unsigned int unit);
+
+    int inflate(unsigned int unit, FILE *fin, const gzip_member &member, FILE *fout, bool to_stdout,
+                size_t &output_total, pipeline_stats &stats);
+    int verify(unsigned int unit, FILE *fin, const gzip_member &member,
+               unsigned int &crc, unsigned int &isize);
+
+  private:
+    device_registry registry;
+};
+
+/***************************************************************//**
+* \brief Threads of the host, which run the kernel code of
+* fpga_data.cpp on host memory, for hosts without a card
+********************************************************************/
+class cpu_backend : public backend
+{
+  public:
+    /***************************************************************//**
+    * @param units number of threads
+    * @param budget host memory for the buffers of all units in bytes
+    ********************************************************************/
+    cpu_backend(unsigned int units, size_t budget);
+
+    const char *name() const { return "cpu"; }
+    unsigned int units() const { return arenas.size(); }
+    cu_buffers &buffers(unsigned int unit) { return acquire(unit); }
+
+    int inflate(unsigned int unit, FILE *fin, const gzip_member &member, FILE *fout, bool to_stdout,
+                size_t &output_total, pipeline_stats &stats);
+    int verify(unsigned int unit, FILE *fin, const gzip_member &member,
+               unsigned int &crc, unsigned int &isize);
+
+  private:
+    /***************************************************************//**
+    * \brief Returns the buffers of a unit, created on first use
+    ********************************************************************/
+    cu_buffers &acquire(unsigned int unit);
+
+    /***************************************************************//**
+    * \brief Inflates a gzip member on a unit, small ones in a single
+    * run of the kernel code, and returns CRC and ISIZE of the output
+    ********************************************************************/
+    int run(unsigned int unit, FILE *fin, const gzip_member &member, FILE *fout, bool to_stdout,
+            unsigned int &crc, unsigned int &isize, size_t &output_total, pipeline_stats &stats);
+
+    unsigned int pairs;
+    std::vector<std::unique_ptr<cu_buffers>> arenas; /**< by unit, created on first use */
+};
+
+/***************************************************************//**
+* \brief The compute units of the cards and threads of the host
+* together. Units 0 to cards.units() - 1 are those of the cards, the
+* others those of the host.
+*
+* Every file costs a launch latency on a card: resetting the buffers
+* and several round trips over PCIe. Small files are done sooner on
+* the host, large ones on a card. A cost_model for each side, which
+* is calibrated by every file inflated, gives the job_scheduler the
+* estimated run time of a file on every unit.
+********************************************************************/
+class hybrid_backend : public backend
+{
+  public:
+    /***************************************************************//**
+    * @param cards backend of the cards
+    * @param host backend of the host
+    * @param verbose print the calibrated cost models on destruction
+    ********************************************************************/
+    hybrid_backend(std::unique_ptr<backend> cards, std::unique_ptr<backend> host, bool verbose);
+    ~hybrid_backend();
+
+    const char *name() const { return "hybrid"; }
+    unsigned int units() const { return cards->units() + host->units(); }
+    cu_buffers &buffers(unsigned int unit);
+
+    double estimate(unsigned int unit, long size, unsigned int isize) const;
+
+    int inflate(unsigned int unit, FILE *fin, const gzip_member &member, FILE *fout, bool to_stdout,
+                size_t &output_total, pipeline_stats &stats);
+    int verify(unsigned int unit, FILE *fin, const gzip_member &member,
+               unsigned int &crc, unsigned int &isize);
+
+  private:
+    /***************************************************************//**
+    * \brief Returns the cost model of the side of a unit
+    ********************************************************************/
+    cost_model &model(unsigned int unit) const;
+
+    std::unique_ptr<backend> cards;
+    std::unique_ptr<backend> host;
+    bool verbose;
+
+    mutable cost_model card_cost;
+    mutable cost_model host_cost;
+};
+
+/***************************************************************//**
+* \brief Opens the backend of the options: "fpga", "cpu", "hybrid" or
+* "auto", which takes the cards and the host together if there are
+* cards and the host alone otherwise. Returns NULL if the backend
+* name is unknown.
+*
+* @param opt options of the decompression
+* @param kernel fpga_uncompress, or fpga_verify for verify
+********************************************************************/
+std::unique_ptr<backend> open_backend(const options &opt, const std::string &kernel);
+
+} //namespace inf
+
+#endif /* BACKEND_H_INCLUDED */
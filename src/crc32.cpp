@@ -0,0 +1,186 @@
+#include "crc32.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INF_CRC32_CLMUL 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/* Slice-by-8 tables of the reflected polynomial 0xEDB88320 */
+struct crc32_tables
+{
+	unsigned int t[8][256];
+
+	crc32_tables()
+	{
+		for (unsigned int n = 0; n < 256; ++n)
+		{
+			unsigned int c = n;
+			for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+			t[0][n] = c;
+		}
+
+		for (unsigned int n = 0; n < 256; ++n)
+		{
+			for (int k = 1; k < 8; ++k) t[k][n] = (t[k - 1][n] >> 8) ^ t[0][t[k - 1][n] & 0xFF];
+		}
+	}
+};
+
+const crc32_tables &tables()
+{
+	static const crc32_tables tab;
+	return tab;
+}
+
+/* Slice-by-8 on the inverted CRC register */
+unsigned int slice8(unsigned int c, const unsigned char *p, size_t length)
+{
+	const crc32_tables &tab = tables();
+
+	while (length >= 8)
+	{
+		unsigned int one = c ^ ((unsigned int) p[0] | (unsigned int) p[1] << 8 | (unsigned int) p[2] << 16 | (unsigned int) p[3] << 24);
+		unsigned int two =      (unsigned int) p[4] | (unsigned int) p[5] << 8 | (unsigned int) p[6] << 16 | (unsigned int) p[7] << 24;
+
+		c = tab.t[7][one & 0xFF] ^ tab.t[6][(one >> 8) & 0xFF] ^ tab.t[5][(one >> 16) & 0xFF] ^ tab.t[4][one >> 24]
+		  ^ tab.t[3][two & 0xFF] ^ tab.t[2][(two >> 8) & 0xFF] ^ tab.t[1][(two >> 16) & 0xFF] ^ tab.t[0][two >> 24];
+
+		p += 8;
+		length -= 8;
+	}
+
+	while (length--) c = tab.t[0][(c ^ *p++) & 0xFF] ^ (c >> 8);
+
+	return c;
+}
+
+#ifdef INF_CRC32_CLMUL
+
+/*
+ * Fold 64 byte blocks with carry-less multiplication on the inverted
+ * CRC register, see Gopal et al., "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction" (Intel, 2009). Needs at
+ * least 64 bytes, length must be a multiple of 16.
+ */
+__attribute__((target("pclmul,sse4.1")))
+unsigned int fold_clmul(unsigned int c, const unsigned char *p, size_t length)
+{
+	/* Bit-reflected folding constants x^(4*128+32), x^(4*128-32), ... and the Barrett constants */
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+	const __m128i k5k0 = _mm_set_epi64x(0x0000000000LL, 0x0163cd6124LL);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+	const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+
+	__m128i x1 = _mm_loadu_si128((const __m128i *) (p + 0x00));
+	__m128i x2 = _mm_loadu_si128((const __m128i *) (p + 0x10));
+	__m128i x3 = _mm_loadu_si128((const __m128i *) (p + 0x20));
+	__m128i x4 = _mm_loadu_si128((const __m128i *) (p + 0x30));
+	__m128i t;
+
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) c));
+
+	p += 64;
+	length -= 64;
+
+	/* Four lanes of 128 bits */
+	while (length >= 64)
+	{
+		t  = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k1k2, 0x11), t), _mm_loadu_si128((const __m128i *) (p + 0x00)));
+		t  = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		x2 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x2, k1k2, 0x11), t), _mm_loadu_si128((const __m128i *) (p + 0x10)));
+		t  = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		x3 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x3, k1k2, 0x11), t), _mm_loadu_si128((const __m128i *) (p + 0x20)));
+		t  = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+		x4 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x4, k1k2, 0x11), t), _mm_loadu_si128((const __m128i *) (p + 0x30)));
+
+		p += 64;
+		length -= 64;
+	}
+
+	/* Fold the lanes into one */
+	t  = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), t), x2);
+	t  = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), t), x3);
+	t  = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), t), x4);
+
+	/* Remaining blocks of 16 */
+	while (length >= 16)
+	{
+		t  = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), t), _mm_loadu_si128((const __m128i *) p));
+
+		p += 16;
+		length -= 16;
+	}
+
+	/* 128 to 64 bits */
+	t  = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), t);
+
+	/* 64 to 32 bits */
+	t  = _mm_srli_si128(x1, 4);
+	x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k5k0, 0x00);
+	x1 = _mm_xor_si128(x1, t);
+
+	/* Barrett reduction */
+	t  = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), poly, 0x10);
+	t  = _mm_clmulepi64_si128(_mm_and_si128(t, mask), poly, 0x00);
+	x1 = _mm_xor_si128(x1, t);
+
+	return (unsigned int) _mm_extract_epi32(x1, 1);
+}
+
+bool detect_clmul()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+}
+
+#endif
+
+} //namespace
+
+bool inf::crc32_has_clmul()
+{
+#ifdef INF_CRC32_CLMUL
+	static const bool has = detect_clmul();
+	return has;
+#else
+	return false;
+#endif
+}
+
+unsigned int inf::crc32_slice8(unsigned int crc, const unsigned char *data, size_t length)
+{
+	return slice8(crc ^ 0xFFFFFFFF, data, length) ^ 0xFFFFFFFF;
+}
+
+unsigned int inf::crc32_update(unsigned int crc, const void *data, size_t length)
+{
+	const unsigned char *p = (const unsigned char *) data;
+	unsigned int c = crc ^ 0xFFFFFFFF;
+
+#ifdef INF_CRC32_CLMUL
+	if (length >= 64 && inf::crc32_has_clmul())
+	{
+		size_t n = length & ~(size_t) 15;
+
+		c = fold_clmul(c, p, n);
+		p += n;
+		length -= n;
+	}
+#endif
+
+	return slice8(c, p, length) ^ 0xFFFFFFFF;
+}
+
+unsigned int inf::crc32(const void *data, unsigned int length)
+{
+	return inf::crc32_update(0, data, length);
+}
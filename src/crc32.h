@@ -0,0 +1,49 @@
+#ifndef CRC32_H_INCLUDED
+#define CRC32_H_INCLUDED
+
+#include <stddef.h>
+
+namespace inf {
+
+/***************************************************************//**
+* \brief Updates a CRC32 (ISO 3309, as used by gzip) with a number
+* of bytes and returns the new value.
+*
+* The CRC is passed and returned in its final form, so the CRC of
+* consecutive pieces is obtained by chaining the calls, starting
+* with 0. Only the new bytes are touched. Blocks of 64 or more bytes
+* are folded with carry-less multiplication if the CPU supports
+* PCLMULQDQ, the rest is computed with slice-by-8 tables.
+*
+* @param crc CRC of the preceding data (0 for none)
+* @param *data pointer to data
+* @param length number of bytes that should be accounted
+********************************************************************/
+unsigned int crc32_update(unsigned int crc, const void *data, size_t length);
+
+/***************************************************************//**
+* Returns a cyclic redundancy checksum of a number of bytes of
+* given input data as specified in ISO 3309 standard. The function
+* may encounter a segmentation fault if the number is larger than
+* the array that contains the data.
+*
+* @param *data pointer to data
+* @param length number of bytes that should be accounted
+********************************************************************/
+unsigned int crc32(const void *data, unsigned int length);
+
+/***************************************************************//**
+* \brief Updates a CRC32 with slice-by-8 tables only, the CRC is
+* passed and returned in its final form as in crc32_update
+********************************************************************/
+unsigned int crc32_slice8(unsigned int crc, const unsigned char *data, size_t length);
+
+/***************************************************************//**
+* \brief Returns true if crc32_update folds with carry-less
+* multiplication on this CPU
+********************************************************************/
+bool crc32_has_clmul();
+
+} //namespace inf
+
+#endif /* CRC32_H_INCLUDED */
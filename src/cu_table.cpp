@@ -0,0 +1,199 @@
+#include "cu_table.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+/* Layout of the xclbin container (axlf), see xclbin.h of XRT */
+const size_t AXLF_NUM_SECTIONS = 448; /**< offset of m_header.m_numSections */
+const size_t AXLF_SECTIONS     = 456; /**< offset of the first section header */
+const size_t SECTION_HEADER    = 40;  /**< size of a section header */
+const size_t IP_DATA           = 80;  /**< size of an ip_data entry */
+const size_t CONNECTION        = 12;  /**< size of a connection entry */
+
+const uint32_t CONNECTIVITY = 7;
+const uint32_t IP_LAYOUT    = 8;
+const uint32_t IP_KERNEL    = 1;
+
+/* Reads a value of type T at offset, false if it is out of range */
+template <typename T>
+bool read(const char *data, size_t size, size_t offset, T &value)
+{
+	if(offset > size || size - offset < sizeof(T)) return false;
+
+	memcpy(&value, data + offset, sizeof(T));
+	return true;
+}
+
+/* Finds the first section of a kind, false if there is none */
+bool find_section(const char *data, size_t size, uint32_t kind, size_t &offset, size_t &length)
+{
+	uint32_t sections;
+	if(!read(data, size, AXLF_NUM_SECTIONS, sections)) return false;
+
+	for(uint32_t i = 0; i < sections; ++i)
+	{
+		size_t header = AXLF_SECTIONS + i * SECTION_HEADER;
+		uint32_t section_kind;
+		uint64_t section_offset, section_size;
+
+		if(!read(data, size, header,      section_kind))   return false;
+		if(!read(data, size, header + 24, section_offset)) return false;
+		if(!read(data, size, header + 32, section_size))   return false;
+
+		if(section_kind == kind && section_offset <= size && section_size <= size - section_offset)
+		{
+			offset = section_offset;
+			length = section_size;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Instance names in natural order, such that _2 comes before _10 */
+bool natural_less(const std::string &a, const std::string &b)
+{
+	if(a.size() != b.size()) return a.size() < b.size();
+	return a < b;
+}
+
+} //namespace
+
+bool inf::cu_table::load(const std::string &binary_file, const char *data, size_t size)
+{
+	units.clear();
+
+	if(!load_xclbin(data, size)) load_manifest(binary_file + ".cus");
+
+	return !units.empty();
+}
+
+bool inf::cu_table::load_xclbin(const char *data, size_t size)
+{
+	if(data == NULL || size < AXLF_SECTIONS || memcmp(data, "xclbin2", 8) != 0) return false;
+
+	size_t layout, layout_size;
+	if(!find_section(data, size, IP_LAYOUT, layout, layout_size)) return false;
+
+	//IP index to compute unit, -1 for IPs that are no kernels
+	int32_t count;
+	std::vector<int> cu_of_ip;
+	std::vector<compute_unit> found;
+
+	if(!read(data + layout, layout_size, 0, count) || count < 0) return false;
+
+	for(int32_t i = 0; i < count; ++i)
+	{
+		size_t entry = 8 + i * IP_DATA;
+		uint32_t type;
+		char name[65] = {0};
+
+		if(!read(data + layout, layout_size, entry, type) || entry + IP_DATA > layout_size) return false;
+		memcpy(name, data + layout + entry + 16, 64);
+
+		//Kernel compute units are named "kernel:instance"
+		const char *colon = strchr(name, ':');
+		if(type != IP_KERNEL || colon == NULL)
+		{
+			cu_of_ip.push_back(-1);
+			continue;
+		}
+
+		compute_unit cu;
+		cu.kernel   = std::string(name, colon - name);
+		cu.instance = std::string(colon + 1);
+
+		cu_of_ip.push_back(found.size());
+		found.push_back(cu);
+	}
+
+	//Memory bank of every connected argument
+	size_t connectivity, connectivity_size;
+	if(find_section(data, size, CONNECTIVITY, connectivity, connectivity_size))
+	{
+		if(read(data + connectivity, connectivity_size, 0, count))
+		{
+			for(int32_t i = 0; i < count; ++i)
+			{
+				int32_t arg, ip, bank;
+				size_t entry = 4 + i * CONNECTION;
+
+				if(!read(data + connectivity, connectivity_size, entry,     arg))  break;
+				if(!read(data + connectivity, connectivity_size, entry + 4, ip))   break;
+				if(!read(data + connectivity, connectivity_size, entry + 8, bank)) break;
+				if(arg < 0 || ip < 0 || ip >= (int32_t) cu_of_ip.size() || cu_of_ip[ip] < 0) continue;
+
+				std::vector<int> &banks = found[cu_of_ip[ip]].banks;
+				if(banks.size() <= (size_t) arg) banks.resize(arg + 1, -1);
+				if(banks[arg] < 0) banks[arg] = bank;
+			}
+		}
+	}
+
+	units.insert(units.end(), found.begin(), found.end());
+	sort();
+
+	return !found.empty();
+}
+
+bool inf::cu_table::load_manifest(const std::string &manifest_file)
+{
+	std::ifstream manifest(manifest_file.c_str());
+	if(!manifest) return false;
+
+	std::string line;
+	while(std::getline(manifest, line))
+	{
+		std::istringstream fields(line.substr(0, line.find('#')));
+		compute_unit cu;
+		std::string bank;
+
+		if(!(fields >> cu.kernel >> cu.instance)) continue;
+		while(fields >> bank) cu.banks.push_back(bank == "-" ? -1 : atoi(bank.c_str()));
+
+		units.push_back(cu);
+	}
+
+	sort();
+
+	return true;
+}
+
+unsigned int inf::cu_table::count(const std::string &kernel) const
+{
+	unsigned int n = 0;
+	for(size_t i = 0; i < units.size(); ++i) n += units[i].kernel == kernel;
+
+	return n;
+}
+
+inf::compute_unit inf::cu_table::unit(const std::string &kernel, unsigned int index) const
+{
+	unsigned int n = 0;
+	for(size_t i = 0; i < units.size(); ++i)
+	{
+		if(units[i].kernel == kernel && n++ == index) return units[i];
+	}
+
+	compute_unit cu;
+	cu.kernel   = kernel;
+	cu.instance = kernel + "_" + std::to_string(index + 1);
+
+	return cu;
+}
+
+void inf::cu_table::sort()
+{
+	std::stable_sort(units.begin(), units.end(), [](const compute_unit &a, const compute_unit &b)
+	{
+		if(a.kernel != b.kernel) return a.kernel < b.kernel;
+		return natural_less(a.instance, b.instance);
+	});
+}
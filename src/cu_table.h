@@ -0,0 +1,98 @@
+#ifndef CU_TABLE_H_INCLUDED
+#define CU_TABLE_H_INCLUDED
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace inf {
+
+/***************************************************************//**
+* \brief A compute unit of the device binary and the memory banks its
+* arguments are connected to
+********************************************************************/
+struct compute_unit {
+    std::string kernel;     /**< kernel name, e.g. fpga_uncompress */
+    std::string instance;   /**< compute unit name, e.g. fpga_uncompress_1 */
+    std::vector<int> banks; /**< memory bank by argument index, -1 if not connected */
+
+    /***************************************************************//**
+    * \brief Returns the name for cl::Kernel, "kernel:{instance}"
+    ********************************************************************/
+    std::string name() const { return kernel + ":{" + instance + "}"; }
+
+    /***************************************************************//**
+    * \brief Returns the memory bank of argument arg, -1 if unknown
+    ********************************************************************/
+    int bank(unsigned int arg) const { return arg < banks.size() ? banks[arg] : -1; }
+};
+
+/***************************************************************//**
+* \brief Compute units of a device binary.
+*
+* The table is read from the IP_LAYOUT, CONNECTIVITY and MEM_TOPOLOGY
+* sections of the xclbin. Binaries without them may come with a
+* manifest next to them (the binary's path with ".cus" appended), a
+* text file with one compute unit per line:
+*
+*     # kernel instance bank-of-arg0 bank-of-arg1 ...
+*     fpga_uncompress fpga_uncompress_1 0 - 0 - 0 0
+*
+* where "-" marks a scalar argument. The compute units of a kernel
+* are numbered from 0 in the natural order of their instance names.
+********************************************************************/
+class cu_table
+{
+  public:
+    /***************************************************************//**
+    * \brief Reads the table from the xclbin in memory, and from the
+    * manifest if the binary has no IP layout. Returns false if no
+    * compute unit was found.
+    *
+    * @param binary_file path to the device binary, for the manifest
+    * @param data contents of the device binary
+    * @param size size of the device binary in bytes
+    ********************************************************************/
+    bool load(const std::string &binary_file, const char *data, size_t size);
+
+    /***************************************************************//**
+    * \brief Reads the compute units from an xclbin (axlf) in memory.
+    * Returns false if it is not an xclbin or has no IP layout.
+    ********************************************************************/
+    bool load_xclbin(const char *data, size_t size);
+
+    /***************************************************************//**
+    * \brief Reads the compute units from a manifest. Returns false if
+    * the file cannot be opened.
+    ********************************************************************/
+    bool load_manifest(const std::string &manifest_file);
+
+    /***************************************************************//**
+    * \brief Returns the number of compute units of kernel
+    ********************************************************************/
+    unsigned int count(const std::string &kernel) const;
+
+    /***************************************************************//**
+    * \brief Returns compute unit index (counted from 0) of kernel. If
+    * the table does not know it, the compute unit "kernel_<index+1>"
+    * without bank assignment is returned, as named by v++ by default.
+    ********************************************************************/
+    compute_unit unit(const std::string &kernel, unsigned int index) const;
+
+    /***************************************************************//**
+    * \brief Returns true if no compute unit is known
+    ********************************************************************/
+    bool empty() const { return units.empty(); }
+
+  private:
+    /***************************************************************//**
+    * \brief Sorts the compute units by kernel and instance name
+    ********************************************************************/
+    void sort();
+
+    std::vector<compute_unit> units;
+};
+
+} //namespace inf
+
+#endif /* CU_TABLE_H_INCLUDED */
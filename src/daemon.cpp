@@ -0,0 +1,490 @@
+#include "daemon.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sstream>
+
+namespace {
+
+/* Most descriptors passed with one message */
+const int MAX_FDS = 16;
+
+/* Fills a socket address, false if the path is too long */
+bool socket_address(const std::string &path, sockaddr_un &address)
+{
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(path.size() >= sizeof(address.sun_path)) return false;
+
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+	return true;
+}
+
+/* Sends all of line, false if the peer is gone */
+bool send_line(int socket, const std::string &line, int fd = -1)
+{
+	size_t sent = 0;
+
+	while(sent < line.size())
+	{
+		iovec data = {(void *)(line.data() + sent), line.size() - sent};
+		msghdr message;
+		char control[CMSG_SPACE(sizeof(int))];
+
+		memset(&message, 0, sizeof(message));
+		message.msg_iov    = &data;
+		message.msg_iovlen = 1;
+
+		//The descriptor goes with the first byte of the line
+		if(fd >= 0 && sent == 0)
+		{
+			memset(control, 0, sizeof(control));
+			message.msg_control    = control;
+			message.msg_controllen = sizeof(control);
+
+			cmsghdr *header = CMSG_FIRSTHDR(&message);
+			header->cmsg_level = SOL_SOCKET;
+			header->cmsg_type  = SCM_RIGHTS;
+			header->cmsg_len   = CMSG_LEN(sizeof(int));
+			memcpy(CMSG_DATA(header), &fd, sizeof(int));
+		}
+
+		ssize_t n = sendmsg(socket, &message, MSG_NOSIGNAL);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return false;
+
+		sent += n;
+	}
+
+	return true;
+}
+
+/* Reads from a socket and appends the bytes to buffer and passed descriptors to fds, false at the end */
+bool receive(int socket, std::string &buffer, std::deque<int> &fds)
+{
+	char data[4096];
+	char control[CMSG_SPACE(MAX_FDS * sizeof(int))];
+	iovec vector = {data, sizeof(data)};
+	msghdr message;
+
+	memset(&message, 0, sizeof(message));
+	message.msg_iov        = &vector;
+	message.msg_iovlen     = 1;
+	message.msg_control    = control;
+	message.msg_controllen = sizeof(control);
+
+	ssize_t n;
+	do n = recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+	while(n < 0 && errno == EINTR);
+	if(n <= 0) return false;
+
+	for(cmsghdr *header = CMSG_FIRSTHDR(&message); header != NULL; header = CMSG_NXTHDR(&message, header))
+	{
+		if(header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) continue;
+
+		size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for(size_t i = 0; i < count; ++i)
+		{
+			int fd;
+			memcpy(&fd, CMSG_DATA(header) + i * sizeof(int), sizeof(int));
+			fds.push_back(fd);
+		}
+	}
+
+	buffer.append(data, n);
+	return true;
+}
+
+} //namespace
+
+inf::daemon_server::daemon_server(const std::string &socket_path, inf::backend &engine, bool verbose)
+  : socket_path(socket_path), engine(engine), verbose(verbose), listener(-1), stopping(false)
+{
+}
+
+int inf::daemon_server::run()
+{
+	sockaddr_un address;
+	if(!socket_address(socket_path, address))
+	{
+		std::cerr << "socket path '" << socket_path << "' is too long\n";
+		return inf::TINF_FILE_ERROR;
+	}
+
+	listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	unlink(socket_path.c_str());
+	if(listener < 0 || bind(listener, (sockaddr *) &address, sizeof(address)) != 0 || listen(listener, 64) != 0)
+	{
+		std::cerr << "unable to listen on '" << socket_path << "': " << strerror(errno) << "\n";
+		if(listener >= 0) close(listener);
+		return inf::TINF_FILE_ERROR;
+	}
+
+	std::cout << "listening on " << socket_path << " with " << engine.units() << " " << engine.name() << " units\n" << std::flush;
+
+	//One thread per unit of the backend, they share the queue
+	std::vector<std::thread> workers;
+	for(unsigned int w = 0; w < engine.units(); ++w) workers.emplace_back(&inf::daemon_server::work, this, w);
+
+	for(;;)
+	{
+		int connection = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+		if(connection < 0)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if(stopping) break;
+			if(errno == EINTR || errno == ECONNABORTED) continue;
+
+			std::cerr << "accept failed: " << strerror(errno) << "\n";
+			stopping = true;
+			break;
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+		clients.insert(connection);
+		std::thread(&inf::daemon_server::serve, this, connection).detach();
+	}
+
+	//Queued jobs are finished first, then the open connections are ended
+	pending.notify_all();
+	for(size_t i = 0; i < workers.size(); ++i) workers[i].join();
+
+	std::unique_lock<std::mutex> guard(lock);
+	for(std::set<int>::iterator c = clients.begin(); c != clients.end(); ++c) ::shutdown(*c, SHUT_RD);
+	idle.wait(guard, [&]() { return clients.empty(); });
+	guard.unlock();
+
+	close(listener);
+	unlink(socket_path.c_str());
+
+	return inf::TINF_OK;
+}
+
+void inf::daemon_server::serve(int connection)
+{
+	//Answers in the order of the requests, written while further requests are read
+	std::mutex answers_lock;
+	std::condition_variable answers_ready;
+	std::deque<std::future<inf::job_result>> answers;
+	bool done = false;
+	job *last = NULL; //Last job with output "-" that has not finished, guarded by lock
+
+	std::thread respond([&]()
+	{
+		bool open = true;
+
+		for(;;)
+		{
+			std::unique_lock<std::mutex> guard(answers_lock);
+			answers_ready.wait(guard, [&]() { return done || !answers.empty(); });
+			if(answers.empty()) return;
+
+			std::future<inf::job_result> answer = std::move(answers.front());
+			answers.pop_front();
+			guard.unlock();
+
+			inf::job_result r = answer.get();
+			std::ostringstream line;
+			line << r.err << " " << r.bytes << " " << r.queued << " " << r.seconds << " " << r.worker << "\n";
+			if(open) open = send_line(connection, line.str());
+		}
+	});
+
+	std::string buffer;
+	std::deque<int> fds;
+
+	while(receive(connection, buffer, fds))
+	{
+		size_t end;
+		while((end = buffer.find('\n')) != std::string::npos)
+		{
+			std::string line = buffer.substr(0, end);
+			buffer.erase(0, end + 1);
+
+			if(line == "shutdown")
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stopping = true;
+				::shutdown(listener, SHUT_RDWR);
+				continue;
+			}
+
+			std::unique_ptr<job> j(new job());
+			size_t tab = line.find('\t');
+			j->input     = line.substr(0, tab);
+			j->output    = tab == std::string::npos ? "" : line.substr(tab + 1);
+			j->fd        = -1;
+			j->submitted = omp_get_wtime();
+			j->last      = NULL;
+
+			if(j->output == "-" && !fds.empty())
+			{
+				j->fd = fds.front();
+				fds.pop_front();
+			}
+
+			std::future<inf::job_result> answer = j->result.get_future();
+
+			//Requests without output are answered at once
+			{
+				std::lock_guard<std::mutex> guard(lock);
+
+				//Invalid requests and requests after shutdown are answered at once
+				if(j->output.empty() || (j->output == "-" && j->fd < 0) || stopping)
+				{
+					inf::job_result r = {inf::TINF_FILE_ERROR, 0, 0, 0, 0};
+					if(j->fd >= 0) close(j->fd);
+					j->result.set_value(r);
+				}
+				else if(j->fd >= 0 && last != NULL)
+				{
+					//Written to the same descriptor as the last one, runs after it
+					j->last = &last;
+					last->next = std::move(j);
+					last = last->next.get();
+				}
+				else
+				{
+					if(j->fd >= 0)
+					{
+						j->last = &last;
+						last = j.get();
+					}
+					jobs.push_back(std::move(j));
+					pending.notify_one();
+				}
+			}
+
+			std::lock_guard<std::mutex> guard(answers_lock);
+			answers.push_back(std::move(answer));
+			answers_ready.notify_one();
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(answers_lock);
+		done = true;
+		answers_ready.notify_one();
+	}
+	respond.join();
+
+	for(size_t i = 0; i < fds.size(); ++i) close(fds[i]);
+
+	std::lock_guard<std::mutex> guard(lock);
+	clients.erase(connection);
+	close(connection);
+	idle.notify_all();
+}
+
+void inf::daemon_server::work(unsigned int worker)
+{
+	for(;;)
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		pending.wait(guard, [&]() { return stopping || !jobs.empty(); });
+		if(jobs.empty()) return;
+
+		std::unique_ptr<job> j = std::move(jobs.front());
+		jobs.pop_front();
+		guard.unlock();
+
+		double start = omp_get_wtime();
+
+		size_t bytes = 0;
+		int err = inflate_job(*j, engine, worker, bytes);
+
+		inf::job_result r = {err, bytes, start - j->submitted, omp_get_wtime() - start, worker};
+
+		{
+			std::lock_guard<std::mutex> print(lock);
+
+			//The next job to the same descriptor is queued once this one has closed it
+			if(j->next)
+			{
+				jobs.push_back(std::move(j->next));
+				pending.notify_one();
+			}
+			else if(j->last != NULL && *j->last == j.get())
+			{
+				*j->last = NULL;
+			}
+
+			if(verbose)
+			{
+				std::cout << "job '" << j->input << "' (#" << worker << "): error code " << err << ", " << bytes << " bytes, "
+				          << r.queued << " s queued, " << r.seconds << " s\n" << std::flush;
+			}
+		}
+
+		j->result.set_value(r);
+	}
+}
+
+int inf::daemon_server::inflate_job(const job &j, inf::backend &engine, unsigned int unit, size_t &bytes)
+{
+	FILE *fin  = fopen(j.input.c_str(), "rb");
+	FILE *fout = j.fd >= 0 ? fdopen(j.fd, "wb") : fopen(j.output.c_str(), "wb");
+
+	if(fout == NULL && j.fd >= 0) close(j.fd);
+
+	int err = fin != NULL && fout != NULL ? inf::TINF_OK : inf::TINF_FILE_ERROR;
+
+	inf::gzip_member member = inf::gzip_member();
+	inf::pipeline_stats stats = inf::pipeline_stats();
+
+	if(err == inf::TINF_OK) err = inf::read_gzip_member(fin, member);
+	if(err == inf::TINF_OK) err = engine.inflate(unit, fin, member, fout, false, bytes, stats);
+
+	if(fin != NULL) fclose(fin);
+
+	//Write errors, e.g. EPIPE if the reader of the descriptor is gone
+	if(fout != NULL)
+	{
+		bool written = fflush(fout) == 0 && !ferror(fout);
+		if(fclose(fout) != 0) written = false;
+		if(!written && err == inf::TINF_OK) err = inf::TINF_FILE_ERROR;
+	}
+
+	return err;
+}
+
+int inf::run_daemon(const inf::options &opt)
+{
+    //A client that goes away fails its own job with EPIPE, not the daemon
+    signal(SIGPIPE, SIG_IGN);
+
+    //The cards stay programmed and the buffers pooled for all jobs
+    std::unique_ptr<inf::backend> engine = inf::open_backend(opt, "fpga_uncompress");
+    if(!engine || engine->units() == 0) return inf::TINF_FILE_ERROR;
+
+    inf::daemon_server server(opt.socket, *engine, opt.verbose);
+
+    return server.run();
+}
+
+int inf::run_client(std::vector<std::string> input_list, const inf::options &opt)
+{
+	int ret = inf::TINF_OK;
+
+	const std::string &socket_path = opt.socket;
+	sockaddr_un address;
+
+	int connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(connection < 0 || !socket_address(socket_path, address) || connect(connection, (sockaddr *) &address, sizeof(address)) != 0)
+	{
+		std::cerr << "unable to connect to '" << socket_path << "'\n";
+		if(connection >= 0) close(connection);
+		return inf::TINF_FILE_ERROR;
+	}
+
+    const std::string &suff = opt.suffix;
+
+	//Output names as in uncompress_file, the requests are sent at once
+	std::vector<std::string> inputs, outputs;
+
+	for(size_t i = 0; i < input_list.size(); ++i)
+	{
+		const std::string &input_file = input_list[i];
+
+		if(input_file.size() < suff.size() || input_file.compare(input_file.size()-suff.size(), suff.size(), suff) != 0)
+		{
+			std::cerr << "'" << input_file.c_str() << "' has wrong suffix\n";
+			ret = inf::TINF_FILE_ERROR;
+			continue;
+		}
+
+		FILE *fin = fopen(input_file.c_str(), "rb");
+		if(fin == NULL)
+		{
+			std::cerr << "unable to open input file '" << input_file.c_str() << "'\n";
+			ret = inf::TINF_FILE_ERROR;
+			continue;
+		}
+
+		inf::gzip_member member = inf::gzip_member();
+		int err = inf::read_gzip_member(fin, member);
+		fclose(fin);
+		if(err != inf::TINF_OK)
+		{
+			ret = err;
+			continue;
+		}
+
+		std::string output_file = member.filename;
+		if(opt.no_name || output_file == "") output_file = input_file.substr(0, input_file.size() - suff.size());
+
+		if(!opt.to_stdout && !opt.force && access(output_file.c_str(), F_OK) == 0)
+		{
+			std::cerr << "output file already exists\n";
+			ret = inf::TINF_FILE_ERROR;
+			continue;
+		}
+
+		std::string request = std::filesystem::absolute(input_file).string() + "\t"
+		                    + (opt.to_stdout ? std::string("-") : std::filesystem::absolute(output_file).string()) + "\n";
+
+		if(!send_line(connection, request, opt.to_stdout ? STDOUT_FILENO : -1))
+		{
+			std::cerr << "connection to '" << socket_path << "' lost\n";
+			ret = inf::TINF_FILE_ERROR;
+			break;
+		}
+
+		inputs.push_back(input_file);
+		outputs.push_back(output_file);
+	}
+	shutdown(connection, SHUT_WR);
+
+	//One answer per request, in order
+	std::string buffer;
+	std::deque<int> fds;
+	size_t answered = 0;
+	std::ostream &log = opt.to_stdout ? std::cerr : std::cout; //With -c the daemon writes the output to standard output
+
+	while(answered < inputs.size() && receive(connection, buffer, fds))
+	{
+		size_t end;
+		while(answered < inputs.size() && (end = buffer.find('\n')) != std::string::npos)
+		{
+			std::istringstream line(buffer.substr(0, end));
+			buffer.erase(0, end + 1);
+
+			inf::job_result r = {inf::TINF_FILE_ERROR, 0, 0, 0, 0};
+			line >> r.err >> r.bytes >> r.queued >> r.seconds >> r.worker;
+
+			const std::string &input_file  = inputs[answered];
+			const std::string &output_file = outputs[answered];
+			++answered;
+
+			if(r.err != inf::TINF_OK) ret = r.err;
+			if(!opt.keep && !opt.to_stdout && r.err == inf::TINF_OK) remove(input_file.c_str());
+
+			if(opt.verbose)
+			{
+				log << "job #" << r.worker << ": " << r.queued << " s queued, " << r.seconds << " s on the compute unit\n";
+			}
+			if(!opt.quiet && r.err == inf::TINF_OK)
+			{
+				log << "decompressed " << r.bytes << " bytes from file '" << input_file << "' (#" << r.worker << ") to " << output_file << "\n";
+			}
+			if(!opt.quiet && r.err != inf::TINF_OK)
+			{
+				std::cerr << "process #" << r.worker << " exited with error code " << r.err << "\n";
+			}
+		}
+	}
+
+	if(answered < inputs.size())
+	{
+		std::cerr << "connection to '" << socket_path << "' lost\n";
+		ret = inf::TINF_FILE_ERROR;
+	}
+
+	for(size_t i = 0; i < fds.size(); ++i) close(fds[i]);
+	close(connection);
+
+	return ret;
+}
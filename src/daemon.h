@@ -0,0 +1,126 @@
+#ifndef DAEMON_H_INCLUDED
+#define DAEMON_H_INCLUDED
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "./backend.h"
+
+namespace inf {
+
+/***************************************************************//**
+* \brief Result of a job of the daemon
+********************************************************************/
+struct job_result {
+    int err;              /**< tinf_error_code */
+    size_t bytes;         /**< number of bytes written */
+    double queued;        /**< seconds in the queue */
+    double seconds;       /**< seconds on the compute unit */
+    unsigned int worker;  /**< worker that ran the job */
+};
+
+/***************************************************************//**
+* \brief Decompression daemon: keeps the cards programmed and the
+* buffers pooled and takes jobs over a Unix domain socket.
+*
+* A client sends one request per line, tab separated:
+*
+*     <input path>\t<output path>\n
+*
+* Paths should be absolute, the daemon does not share the working
+* directory of the client. The output path "-" writes to a file
+* descriptor passed with the request (SCM_RIGHTS), e.g. the standard
+* output of the client. The answer to every request is a line
+*
+*     <tinf_error_code> <bytes> <seconds queued> <seconds run> <worker>\n
+*
+* in the order of the requests. Requests of a connection are queued
+* at once, so a client may send all of them before it reads the
+* answers. The line "shutdown" stops the daemon. Jobs of all
+* connections run on one thread per unit of the backend; the jobs
+* with output "-" of a connection run one after the other in the
+* order of the requests, so their outputs are not interleaved.
+********************************************************************/
+class daemon_server
+{
+  public:
+    /***************************************************************//**
+    * @param socket_path path of the socket, an existing one is replaced
+    * @param engine backend the jobs run on
+    * @param verbose print every job on standard output
+    ********************************************************************/
+    daemon_server(const std::string &socket_path, backend &engine, bool verbose);
+
+    /***************************************************************//**
+    * \brief Accepts connections until a client requests shutdown.
+    * Returns a tinf_error_code.
+    ********************************************************************/
+    int run();
+
+  private:
+    /* A queued request */
+    struct job {
+      std::string input;
+      std::string output;
+      int fd;                          /**< output descriptor if output is "-", else -1 */
+      double submitted;                /**< time of submission */
+      std::promise<job_result> result;
+      std::unique_ptr<job> next;       /**< job with output "-" of the same connection queued after this one */
+      job **last;                      /**< last job with output "-" of the connection, if fd >= 0 */
+    };
+
+    /***************************************************************//**
+    * \brief Reads the requests of a connection, queues them and
+    * answers them in order
+    ********************************************************************/
+    void serve(int connection);
+
+    /***************************************************************//**
+    * \brief Runs jobs on a unit of the backend until shutdown
+    ********************************************************************/
+    void work(unsigned int worker);
+
+    /***************************************************************//**
+    * \brief Inflates the gzip file input to output or fd on a unit,
+    * returns a tinf_error_code
+    ********************************************************************/
+    static int inflate_job(const job &j, backend &engine, unsigned int unit, size_t &bytes);
+
+    std::string socket_path;
+    backend &engine;
+    bool verbose;
+    int listener;                   /**< listening socket */
+
+    std::mutex lock;
+    std::condition_variable pending;
+    std::deque<std::unique_ptr<job>> jobs; /**< jobs of all connections, first come first served, except chained ones */
+    std::set<int> clients;          /**< open connections */
+    std::condition_variable idle;   /**< notified when a connection is closed */
+    bool stopping;
+};
+
+/***************************************************************//**
+* \brief Runs the daemon on the socket of the options, with their
+* device binary and memory budget. Returns a tinf_error_code.
+*
+* @param opt options of the decompression
+********************************************************************/
+int run_daemon(const options &opt);
+
+/***************************************************************//**
+* \brief Forwards the files to the daemon at the socket of the
+* options, with the output names of gzip_uncompress, and prints the
+* answers. Returns a tinf_error_code, the last one of all files.
+*
+* @param input_list contains paths to gzip files (absolute or relative)
+* @param opt options of the decompression
+********************************************************************/
+int run_client(std::vector<std::string> input_list, const options &opt);
+
+} //namespace inf
+
+#endif /* DAEMON_H_INCLUDED */
@@ -0,0 +1,177 @@
+#include "decompressor.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+/* Writes of a FILE opened with fopencookie go to a sink */
+ssize_t write_sink(void *cookie, const char *data, size_t length)
+{
+	(*(const inf::decompressor::sink *) cookie)((const unsigned char *) data, length);
+	return length;
+}
+
+} //namespace
+
+inf::decompressor::decompressor(const inf::options &opt)
+  : opt(opt), engine(inf::open_backend(opt, "fpga_uncompress"))
+{
+	for(unsigned int w = units(); w > 0; --w) idle.push_back(w - 1);
+}
+
+int inf::decompressor::decompress(const void *in, size_t in_length, void *out, size_t out_capacity, size_t &out_length)
+{
+	bool overflow = false;
+	out_length = 0;
+
+	int err = decompress(in, in_length, [&](const unsigned char *data, size_t length)
+	{
+		if(overflow || length > out_capacity - out_length)
+		{
+			overflow = true;
+			return;
+		}
+
+		memcpy((unsigned char *) out + out_length, data, length);
+		out_length += length;
+	});
+
+	if(overflow && err == inf::TINF_OK) err = inf::TINF_BUF_ERROR;
+
+	return err;
+}
+
+int inf::decompressor::decompress(const void *in, size_t in_length, const sink &output)
+{
+	if(units() == 0) return inf::TINF_FILE_ERROR;
+	if(in_length < 18) return inf::TINF_DATA_ERROR;
+
+	//The file functions of the host read from and write to memory
+	cookie_io_functions_t functions = {NULL, write_sink, NULL, NULL};
+	FILE *fin  = fmemopen(const_cast<void *>(in), in_length, "rb");
+	FILE *fout = fopencookie(const_cast<sink *>(&output), "wb", functions);
+
+	int err = fin != NULL && fout != NULL ? inf::TINF_OK : inf::TINF_FILE_ERROR;
+	if(fout != NULL) setvbuf(fout, NULL, _IONBF, 0); //Chunks go to the sink as they are
+
+	inf::gzip_member member = inf::gzip_member();
+	if(err == inf::TINF_OK) err = inf::read_gzip_member(fin, member);
+
+	if(err == inf::TINF_OK)
+	{
+		unsigned int worker = acquire(member.srclen, member.isize);
+		size_t output_total = 0;
+		inf::pipeline_stats stats = inf::pipeline_stats();
+
+		err = engine->inflate(worker, fin, member, fout, false, output_total, stats);
+
+		release(worker);
+	}
+
+	if(fin  != NULL) fclose(fin);
+	if(fout != NULL) fclose(fout);
+
+	return err;
+}
+
+int inf::decompressor::decompress_stream(FILE *in, FILE *out)
+{
+	if(units() == 0) return inf::TINF_FILE_ERROR;
+
+	//The length is not known, the unit best for large files
+	unsigned int worker = acquire(LONG_MAX, UINT_MAX);
+
+	int err = inf::uncompress_pipe(in, out, *engine, worker, opt);
+
+	release(worker);
+
+	return err;
+}
+
+int inf::decompressor::decompress_files(const std::vector<std::string> &input_list)
+{
+	cl_int ret = inf::TINF_OK;
+
+	if(units() == 0) return inf::TINF_FILE_ERROR;
+
+	//Standard input first, it cannot be scheduled by its size
+	std::vector<std::string> files;
+	for(size_t i = 0; i < input_list.size(); ++i)
+	{
+		if(input_list[i] != "-") files.push_back(input_list[i]);
+		else if(ret == inf::TINF_OK) ret = decompress_stream(stdin, stdout);
+	}
+
+	if(opt.list && opt.listing != NULL) *opt.listing << "compressed\t uncompressed\t ratio\t uncompressed_name\n";
+
+	//Largest files first on the unit that finishes them first, idle units steal pending files of busy ones
+	inf::job_scheduler scheduler(files, units(), [&](unsigned int unit, long size, unsigned int isize)
+	{
+		return engine->estimate(unit, size, isize);
+	});
+
+#pragma omp parallel num_threads(units())
+{
+	//Every thread holds a unit of its own before any gives one back, so no queue is left without its unit
+	unsigned int worker = acquire(0, 0);
+	std::string input_file;
+	#pragma omp barrier
+
+	while(scheduler.next(worker, input_file))
+	{
+		int err = inf::uncompress_file(input_file, *engine, worker, opt);
+
+		#pragma omp critical
+		if(err != inf::TINF_OK) ret = err;
+	}
+
+	release(worker);
+}
+	return ret;
+}
+
+unsigned int inf::decompressor::acquire(long size, unsigned int isize)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	released.wait(guard, [&]() { return !idle.empty(); });
+
+	//The free worker that finishes the file first, the last freed one of equal ones
+	size_t best = idle.size() - 1;
+	for(size_t i = idle.size() - 1; i-- > 0;)
+	{
+		if(engine->estimate(idle[i], size, isize) < engine->estimate(idle[best], size, isize)) best = i;
+	}
+
+	unsigned int worker = idle[best];
+	idle.erase(idle.begin() + best);
+
+	return worker;
+}
+
+void inf::decompressor::release(unsigned int worker)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	idle.push_back(worker);
+	released.notify_one();
+}
+
+int inf::gzip_uncompress(std::vector<std::string> input_list, const inf::options &opt)
+{
+	//Standard input if there are no files, as gunzip does
+	if(input_list.empty())
+	{
+		if(isatty(STDIN_FILENO))
+		{
+			std::cerr << "compressed data not read from a terminal\n";
+			return inf::TINF_FILE_ERROR;
+		}
+		input_list.push_back("-");
+	}
+
+	//All cards, programmed in parallel, or the host; buffers of every unit are created once
+	inf::decompressor engine(opt);
+
+	return engine.decompress_files(input_list);
+}
@@ -0,0 +1,138 @@
+#ifndef DECOMPRESSOR_H_INCLUDED
+#define DECOMPRESSOR_H_INCLUDED
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "./backend.h"
+
+namespace inf {
+
+/***************************************************************//**
+* \brief Gzip decompression on the accelerator cards for embedding
+* into other programs.
+*
+* The backend of the options is opened once, when the object is
+* created: the cards are programmed and the buffers of their compute
+* units pooled, or without cards the host runs the kernel code, see
+* open_backend. All functions may be called from any thread: a call
+* runs on a free unit and waits while all of them are busy.
+*
+* The in-memory functions take a complete gzip file, the kernel needs
+* the length of the deflate stream from the footer before it starts.
+* The output is produced chunk by chunk while the kernel runs; it is
+* either copied into a buffer or handed to a sink, so no temporary
+* file is needed and the output does not have to fit into memory.
+* Nothing is printed by these functions except errors of the device.
+********************************************************************/
+class decompressor
+{
+  public:
+    /***************************************************************//**
+    * \brief Receives the output of a decompression chunk by chunk
+    ********************************************************************/
+    typedef std::function<void(const unsigned char *data, size_t length)> sink;
+
+    /***************************************************************//**
+    * @param opt options, of which backend, binary and memory are used
+    *        for the backend and all others by decompress_files
+    ********************************************************************/
+    explicit decompressor(const options &opt = options());
+
+    /***************************************************************//**
+    * \brief Returns the number of units of the backend, e.g. the
+    * compute units of all cards, 0 if the backend could not be opened
+    ********************************************************************/
+    unsigned int units() const { return engine ? engine->units() : 0; }
+
+    /***************************************************************//**
+    * \brief Returns the name of the backend, "fpga", "cpu" or "hybrid"
+    ********************************************************************/
+    const char *backend_name() const { return engine ? engine->name() : "none"; }
+
+    /***************************************************************//**
+    * \brief Decompresses a gzip file in memory into a buffer. Returns
+    * a tinf_error_code, TINF_BUF_ERROR if the output does not fit.
+    *
+    * @param in gzip file
+    * @param in_length length of the gzip file in bytes
+    * @param out buffer for the output
+    * @param out_capacity size of the buffer in bytes
+    * @param out_length gets overridden with the length of the output
+    ********************************************************************/
+    int decompress(const void *in, size_t in_length, void *out, size_t out_capacity, size_t &out_length);
+
+    /***************************************************************//**
+    * \brief Decompresses a gzip file in memory and hands the output to
+    * a sink in the order of the data. Returns a tinf_error_code; the
+    * sink may have received output before an error was found.
+    *
+    * @param in gzip file
+    * @param in_length length of the gzip file in bytes
+    * @param output receives the output, called from the calling thread
+    *        or a writer thread of the buffer pipeline
+    ********************************************************************/
+    int decompress(const void *in, size_t in_length, const sink &output);
+
+    /***************************************************************//**
+    * \brief Decompresses a gzip stream of unknown length, e.g. a pipe,
+    * see uncompress_pipe. Returns a tinf_error_code.
+    *
+    * @param in input stream, read until its end
+    * @param out output stream
+    ********************************************************************/
+    int decompress_stream(FILE *in, FILE *out);
+
+    /***************************************************************//**
+    * \brief Uncompresses gzip files with the file options of opt, as
+    * the command line tool does. Largest files first on all compute
+    * units, see job_scheduler. The file "-" is standard input, which is
+    * uncompressed to standard output first. Returns a tinf_error_code,
+    * the last one of all files.
+    *
+    * @param input_list contains paths to gzip files (absolute or relative)
+    ********************************************************************/
+    int decompress_files(const std::vector<std::string> &input_list);
+
+  private:
+    /***************************************************************//**
+    * \brief Waits for a free unit of the backend and takes the one
+    * with the lowest estimate for a file, see backend::estimate
+    ********************************************************************/
+    unsigned int acquire(long size, unsigned int isize);
+
+    /***************************************************************//**
+    * \brief Gives a worker back
+    ********************************************************************/
+    void release(unsigned int worker);
+
+    options opt;
+    std::unique_ptr<backend> engine;
+
+    std::mutex lock;
+    std::condition_variable released;
+    std::vector<unsigned int> idle; /**< free workers */
+};
+
+/***************************************************************//**
+* \brief Uncompresses a number of gzip files
+*
+* Depending on specific options the function decompresses gzip
+* files possibly in parallel. Output files are created
+* automatically. The output names also depend on options.
+* Without files standard input is uncompressed to standard output,
+* unless it is a terminal.
+* Any number of files is accepted: one OpenMP thread per compute
+* unit of the backend takes files from a job_scheduler until all are
+* done, see backend and decompressor.
+*
+* @param input_list contains paths to gzip files (absolute or relative)
+* @param opt options of the decompression
+********************************************************************/
+int gzip_uncompress(std::vector<std::string> input_list, const options &opt);
+
+} //namespace inf
+
+#endif /* DECOMPRESSOR_H_INCLUDED */
@@ -1,4 +1,10 @@
 #include "fpga_data.h"
+#include "statictree.h"
+
+#ifndef __SYNTHESIS__
+#include <functional>
+#include <thread>
+#endif
 
 unsigned int fpga::read_le16(unsigned char const *p)
 {
@@ -7,40 +13,6 @@ unsigned int fpga::read_le16(unsigned char const *p)
 	return ((unsigned int) p[0]) | ((unsigned int) p[1] << 8);
 }
 
-/* Build fixed Huffman trees */
-void fpga::build_fixed_trees(struct fpga::tinf_tree *lt, struct fpga::tinf_tree *dt)
-{
-#pragma HLS inline region
-
-	int i;
-
-	// Build fixed literal/length tree
-	for (i = 0; i < 16; ++i) lt->counts[i] = 0;
-
-	lt->counts[7] = 24;
-	lt->counts[8] = 152;
-	lt->counts[9] = 112;
-
-	for (i = 0; i <  24; ++i) lt->symbols[i] = 256 + i;
-
-	for (i = 0; i < 144; ++i) lt->symbols[24 + i] = i;
-
-	for (i = 0; i <   8; ++i) lt->symbols[24 + 144 + i] = 280 + i;
-
-	for (i = 0; i < 112; ++i) lt->symbols[24 + 144 + 8 + i] = 144 + i;
-
-	// Build fixed distance tree
-	for (i = 0; i < 16; ++i) dt->counts[i] = 0;
-
-	dt->counts[5] = 32;
-
-	for (i = 0;  i <  32; ++i) dt->symbols[i] = i;
-	for (i = 32; i < 288; ++i) dt->symbols[i] = 0;
-
-	lt->max_sym = 285;
-	dt->max_sym = 29;
-}
-
 /* Given an array of code lengths, build a tree */
 int fpga::build_tree(struct fpga::tinf_tree *t, const unsigned char *lengths, unsigned int num)
 {
@@ -108,43 +80,153 @@ int fpga::build_tree(struct fpga::tinf_tree *t, const unsigned char *lengths, un
 		t->symbols[1] = t->max_sym + 1;
 	}
 
+	/* Literal/length alphabets get the wide primary table */
+	fpga::build_table(t, num > 32 ? fpga::TINF_LTABLE_BITS : fpga::TINF_DTABLE_BITS);
+
 	return fpga::TINF_OK;
 }
 
-/* -- Decode functions -- */
-
-int fpga::refill(struct fpga::tinf_data *d, int num)
+/* Given counts and symbols of a tree, build its lookup table */
+void fpga::build_table(struct fpga::tinf_tree *t, int root)
 {
 #pragma HLS inline region
 
-	assert(num >= 0 && num <= 32);
+	unsigned short left[16];
+	unsigned int size = 1U << root;
+	unsigned int next = size;     /* first free entry behind the primary table */
+	unsigned int code = 0;        /* canonical code of the current symbol */
+	unsigned int low  = size;     /* primary index of the current sub-table */
+	unsigned int sub_bits = 0;    /* index bits of the current sub-table */
+	unsigned int sub_base = 0;    /* offset of the current sub-table */
+	int max = 0, idx = 0;
 
-	unsigned int help;
+	build_table_1: for (int len = 0; len < 16; ++len)
+	{
+		left[len] = t->counts[len];
+		if (t->counts[len]) max = len;
+	}
 
-	/* Read bytes until at least num bits available */
-	//while (d->bitcount < num)
-	refill: for(int i = 0; i < 3; ++i)
+	/* Unused entries decode to a symbol above any max_sym */
+	build_table_2: for (unsigned int i = 0; i < size; ++i)
 	{
 	#pragma HLS PIPELINE
+		t->table[i].sym  = 0xFFFF;
+		t->table[i].bits = 1;
+		t->table[i].sub  = 0;
+	}
 
-		if(d->bitcount >= num) break;
-
-		if(d->source != d->source_end)
-		////if(d->shift != d->sourceLen-1)
+	build_table_3: for (int len = 1; len <= max; ++len)
+	{
+		build_table_4: for (unsigned int k = 0; k < t->counts[len]; ++k)
 		{
-			//d->tag |= (unsigned int) *d->source++ << d->bitcount;
-			help = (unsigned int) *d->source << d->bitcount;
-			d->tag |= help;
-			*d->source++;
+			unsigned int sym = t->symbols[idx++];
+			unsigned int rev = 0;
+
+			/* Codes are stored MSB first, the bit stream is LSB first */
+			build_table_5: for (int b = 0; b < len; ++b)
+			{
+			#pragma HLS UNROLL
+				rev |= ((code >> b) & 1) << (len - 1 - b);
+			}
+
+			if (len <= root)
+			{
+				build_table_6: for (unsigned int i = rev; i < size; i += 1U << len)
+				{
+				#pragma HLS PIPELINE
+					t->table[i].sym  = sym;
+					t->table[i].bits = len;
+					t->table[i].sub  = 0;
+				}
+			}
+			else
+			{
+				if ((rev & (size - 1)) != low)
+				{
+					/* Size the sub-table to hold all codes sharing this prefix */
+					int curr = len - root;
+					int avail = 1 << curr;
+
+					build_table_7: while (curr + root < max)
+					{
+						avail -= left[curr + root];
+						if (avail <= 0) break;
+						++curr;
+						avail <<= 1;
+					}
+
+					sub_base = next;
+					sub_bits = curr;
+					next += 1U << curr;
+					low = rev & (size - 1);
+
+					assert(next <= (unsigned int) fpga::TINF_TABLE_SIZE);
+
+					t->table[low].sym  = sub_base;
+					t->table[low].bits = sub_bits;
+					t->table[low].sub  = 1;
+				}
+
+				build_table_8: for (unsigned int i = rev >> root; i < (1U << sub_bits); i += 1U << (len - root))
+				{
+				#pragma HLS PIPELINE
+					t->table[sub_base + i].sym  = sym;
+					t->table[sub_base + i].bits = len - root;
+					t->table[sub_base + i].sub  = 0;
+				}
+			}
 
-			d->src_shift++;
+			--left[len];
+			++code;
 		}
-		else d->overflow = 1;
 
-		d->bitcount += 8;
+		code <<= 1;
 	}
+}
+
+/* -- Decode functions -- */
+
+int fpga::refill(struct fpga::tinf_data *d, int num)
+{
+#pragma HLS inline region
+
+	assert(num >= 0 && num <= 56);
+
+	if(d->bitcount >= num) return 0;
+
+	/* Bytes that fit completely into the accumulator */
+	unsigned int n = (63 - d->bitcount) >> 3;
+	unsigned long long bytes = d->stage;
+	unsigned int count = d->stage_bytes;
 
-	assert(d->bitcount <= 32);
+	if(count < n && d->words_left > 0)
+	{
+		/* Staged bytes run short: append the next word of the input stream */
+		unsigned long long w = d->words->read();
+		unsigned int wb = d->bytes_left < 8 ? d->bytes_left : 8;
+		unsigned int take = n - count < wb ? n - count : wb;
+
+		bytes |= w << (8 * count);
+		count += take;
+
+		d->stage = w >> (8 * take);
+		d->stage_bytes = wb - take;
+		d->words_left--;
+		d->bytes_left -= wb;
+	}
+	else
+	{
+		if(count > n) count = n;
+
+		d->stage = count < 8 ? d->stage >> (8 * count) : 0;
+		d->stage_bytes -= count;
+	}
+
+	d->tag |= (bytes & ((1ULL << (8 * count)) - 1)) << d->bitcount;
+	d->src_shift += count;
+	d->bitcount += 8 * count;
+
+	assert(d->bitcount <= 64);
 
 	return 0;
 }
@@ -155,10 +237,17 @@ unsigned int fpga::getbits_no_refill(struct fpga::tinf_data *d, int num)
 
 	unsigned int bits;
 
-	assert(num >= 0 && num <= d->bitcount);
+	assert(num >= 0);
+
+	/* Consuming bits beyond the end of source */
+	if (num > d->bitcount)
+	{
+		d->overflow = 1;
+		num = d->bitcount;
+	}
 
 	/* Get bits from tag */
-	bits = d->tag & ((1UL << num) - 1);
+	bits = d->tag & ((1ULL << num) - 1);
 
 	/* Remove bits from tag */
 	d->tag >>= num;
@@ -176,6 +265,18 @@ unsigned int fpga::getbits(struct fpga::tinf_data *d, int num)
 	return fpga::getbits_no_refill(d, num);
 }
 
+/* Give back whole unused bytes of the bit accumulator */
+void fpga::rewind(struct fpga::tinf_data *d)
+{
+#pragma HLS inline region
+
+	unsigned int n = d->bitcount >> 3;
+
+	d->src_shift -= n;
+	d->bitcount &= 7;
+	d->tag &= (1ULL << d->bitcount) - 1;
+}
+
 /* Read a num bit value from stream and add base */
 unsigned int fpga::getbits_base(struct fpga::tinf_data *d, int num, int base)
 {
@@ -183,42 +284,27 @@ unsigned int fpga::getbits_base(struct fpga::tinf_data *d, int num, int base)
 	return base + (num ? fpga::getbits(d, num) : 0);
 }
 
-/* Given a data stream and a tree, decode a symbol */
-int fpga::decode_symbol(struct fpga::tinf_data *d, const struct fpga::tinf_tree *t)
+/* Given a data stream and a lookup table, decode a symbol */
+template <int ROOT, bool SUB>
+int fpga::decode_symbol(struct fpga::tinf_data *d, const struct fpga::tinf_entry *table)
 {
-	int base = 0, offs = 0;
-	int len;
-
-	/*
-	 * Get more bits while code index is above number of codes
-	 *
-	 * Rather than the actual code, we are computing the position of the
-	 * code in the sorted order of codes, which is the index of the
-	 * corresponding symbol.
-	 *
-	 * Conceptually, for each code length (level in the tree), there are
-	 * counts[len] leaves on the left and internal nodes on the right.
-	 * The index we have decoded so far is base + offs, and if that
-	 * falls within the leaves we are done. Otherwise we adjust the range
-	 * of offs and add one more bit to it.
-	 */
-	decode_symbol: for (len = 1; len <= 15; ++len)
-	{
-        #pragma HLS PIPELINE
-
-		offs = 2 * offs + fpga::getbits(d, 1);
+#pragma HLS inline region
 
-		assert(len <= 15);
+	/* Longest code is 15 bits */
+	fpga::refill(d, 15);
 
-		if (offs < t->counts[len]) break;
+	struct fpga::tinf_entry e = table[d->tag & ((1U << ROOT) - 1)];
 
-		base += t->counts[len];
-		offs -= t->counts[len];
+	if (SUB && e.sub)
+	{
+		/* Code is longer than root, continue in sub-table */
+		fpga::getbits_no_refill(d, ROOT);
+		e = table[e.sym + (d->tag & ((1U << e.bits) - 1))];
 	}
 
-	assert(base + offs >= 0 && base + offs < 288);
+	fpga::getbits_no_refill(d, e.bits);
 
-	return t->symbols[base + offs];
+	return e.sym;
 }
 
 /* Given a data stream, decode dynamic trees from it */
@@ -228,7 +314,7 @@ int fpga::decode_trees(struct fpga::tinf_data *d, struct fpga::tinf_tree *lt, st
 
 	int res;
 
-	unsigned char lengths[288 + 32];
+	unsigned char *lengths = d->lengths;
 
 	/* Special ordering of code length codes */
 	static const unsigned char clcidx[19] = {
@@ -280,7 +366,7 @@ int fpga::decode_trees(struct fpga::tinf_data *d, struct fpga::tinf_tree *lt, st
 	{
         #pragma HLS PIPELINE
 
-		int sym = fpga::decode_symbol(d, lt);
+		int sym = fpga::decode_symbol<fpga::TINF_DTABLE_BITS, true>(d, lt->table);
 
 		if (sym > lt->max_sym) return fpga::TINF_DATA_ERROR;
 
@@ -321,20 +407,284 @@ int fpga::decode_trees(struct fpga::tinf_data *d, struct fpga::tinf_tree *lt, st
 	/* Check EOB symbol is present */
 	if (lengths[256] == 0) return fpga::TINF_DATA_ERROR;
 
-	/* Build dynamic trees */
-	res = fpga::build_tree(lt, lengths, hlit);
-	if (res != fpga::TINF_OK) return res;
+	/* Keep code lengths, the trees are rebuilt from them when the block is resumed */
+	d->hlit = hlit;
+	d->hdist = hdist;
 
-	res = fpga::build_tree(dt, lengths + hlit, hdist);
+	return fpga::build_trees(d, lt, dt);
+}
+
+/* Build dynamic trees from the code lengths kept in d */
+int fpga::build_trees(struct fpga::tinf_data *d, struct fpga::tinf_tree *lt, struct fpga::tinf_tree *dt)
+{
+#pragma HLS inline region
+
+	int res = fpga::build_tree(lt, d->lengths, d->hlit);
 	if (res != fpga::TINF_OK) return res;
 
-	return fpga::TINF_OK;
+	return fpga::build_tree(dt, d->lengths + d->hlit, d->hdist);
+}
+
+/* -- Match copy functions -- */
+
+/* Copy whole chunks of W bytes, the source must lie W or more bytes back */
+template <unsigned int W>
+unsigned int fpga::copy_wide(unsigned char *dst, unsigned int length, unsigned int offs)
+{
+#pragma HLS inline region
+
+	assert(offs >= W && W % 8 == 0);
+
+	unsigned int i;
+
+	copy_wide: for (i = 0; i + W <= length; i += W)
+	{
+	#pragma HLS PIPELINE
+		for (unsigned int k = 0; k < W; k += 8)
+		{
+		#pragma HLS UNROLL
+			fpga::write_le64(dst + i + k, fpga::read_le64(dst + i + k - offs));
+		}
+	}
+
+	return i;
+}
+
+/* Copy a match of length bytes from offs bytes back */
+void fpga::copy_match(unsigned char *dst, unsigned int length, unsigned int offs, unsigned int room)
+{
+#pragma HLS inline region
+
+	unsigned int i = 0;
+
+	/* Chunks may run up to 7 bytes over the match if there is room */
+	unsigned int span = (room - length >= 8) ? (length + 7) & ~7U : length;
+
+	if (offs >= 64)
+	{
+		/* Long distance: source and destination never overlap within a chunk */
+		i  = fpga::copy_wide<64>(dst, span, offs);
+		i += fpga::copy_wide<8>(dst + i, span - i, offs);
+	}
+	else if (offs >= 16)
+	{
+		i  = fpga::copy_wide<16>(dst, span, offs);
+		i += fpga::copy_wide<8>(dst + i, span - i, offs);
+	}
+	else if (offs >= 8)
+	{
+		i = fpga::copy_wide<8>(dst, span, offs);
+	}
+	else
+	{
+		/* Short distance: repeat the last offs bytes as an 8 byte pattern */
+		unsigned long long pattern = 0;
+		unsigned int step = 8 - 8 % offs; /* largest multiple of offs within a word */
+
+		if (offs == 1)
+		{
+			/* Run of one byte value */
+			pattern = dst[-1] * 0x0101010101010101ULL;
+		}
+		else
+		{
+			copy_pattern: for (unsigned int k = 0; k < 8; ++k)
+			{
+			#pragma HLS UNROLL
+				pattern |= (unsigned long long) dst[(int) (k % offs) - (int) offs] << (8 * k);
+			}
+		}
+
+		copy_fill: for (; i + 8 <= span; i += step)
+		{
+		#pragma HLS PIPELINE
+			fpga::write_le64(dst + i, pattern);
+		}
+	}
+
+	/* Remaining bytes */
+	copy_tail: for (; i < length; ++i)
+	{
+	#pragma HLS PIPELINE
+		dst[i] = dst[(int) i - (int) offs];
+	}
+}
+
+/* Copy the part of a match that lies in front of the output chunk from the window */
+unsigned int fpga::copy_history(struct fpga::tinf_output *o, unsigned int length, unsigned int offs)
+{
+#pragma HLS inline region
+
+	unsigned int produced = o->dest - o->dest_start;
+
+	if (offs <= produced) return 0;
+
+	unsigned int count = offs - produced < length ? offs - produced : length;
+
+	copy_history: for (unsigned int i = 0; i < count; ++i)
+	{
+	#pragma HLS PIPELINE
+		o->dest[i] = o->window[(produced + i - offs) & (fpga::TINF_WINDOW_SIZE - 1)];
+	}
+
+	return count;
+}
+
+/* Write a match to the output, its source may lie in the window */
+void fpga::write_match(struct fpga::tinf_output *o, unsigned int length, unsigned int offs)
+{
+#pragma HLS inline region
+
+	unsigned int room = o->dest_end - o->dest;
+	unsigned int count = fpga::copy_history(o, length, offs);
+
+	if (length > count) fpga::copy_match(o->dest + count, length - count, offs, room - count);
+
+	o->dest += length;
+}
+
+/* Append the output of this run to the window */
+void fpga::update_window(struct fpga::tinf_output *o)
+{
+#pragma HLS inline region
+
+	unsigned int produced = o->dest - o->dest_start;
+	unsigned int first = produced > fpga::TINF_WINDOW_SIZE ? produced - fpga::TINF_WINDOW_SIZE : 0;
+
+	update_window: for (unsigned int i = first; i < produced; ++i)
+	{
+	#pragma HLS PIPELINE
+		o->window[i & (fpga::TINF_WINDOW_SIZE - 1)] = o->dest_start[i];
+	}
+}
+
+/* -- CRC functions -- */
+
+/* Fill the slice-by-8 tables of the CRC32 polynomial */
+void fpga::crc_tables(unsigned int tab[8][256])
+{
+#pragma HLS inline region
+
+	crc_tables_1: for (unsigned int n = 0; n < 256; ++n)
+	{
+	#pragma HLS PIPELINE
+		unsigned int c = n;
+
+		for (int k = 0; k < 8; ++k)
+		{
+		#pragma HLS UNROLL
+			c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+		}
+
+		tab[0][n] = c;
+	}
+
+	crc_tables_2: for (int k = 1; k < 8; ++k)
+	{
+		crc_tables_3: for (unsigned int n = 0; n < 256; ++n)
+		{
+		#pragma HLS PIPELINE
+			tab[k][n] = (tab[k - 1][n] >> 8) ^ tab[0][tab[k - 1][n] & 0xFF];
+		}
+	}
+}
+
+/* Update the inverted CRC register with a byte */
+unsigned int fpga::crc_byte(const unsigned int tab[8][256], unsigned int crc, unsigned char b)
+{
+#pragma HLS inline
+
+	return tab[0][(crc ^ b) & 0xFF] ^ (crc >> 8);
+}
+
+/* Update the inverted CRC register with eight bytes */
+unsigned int fpga::crc_word(const unsigned int tab[8][256], unsigned int crc, unsigned long long w)
+{
+#pragma HLS inline
+
+	unsigned int one = crc ^ (unsigned int) w;
+	unsigned int two = (unsigned int) (w >> 32);
+
+	return tab[7][one & 0xFF] ^ tab[6][(one >> 8) & 0xFF] ^ tab[5][(one >> 16) & 0xFF] ^ tab[4][one >> 24]
+	     ^ tab[3][two & 0xFF] ^ tab[2][(two >> 8) & 0xFF] ^ tab[1][(two >> 16) & 0xFF] ^ tab[0][two >> 24];
+}
+
+/* -- Token functions -- */
+
+/* Pass a literal to the expand stage */
+void fpga::put_literal(struct fpga::tinf_data *d, unsigned int lit)
+{
+#pragma HLS inline region
+
+	struct fpga::tinf_token t = {0, (unsigned short) lit, 0};
+	d->tokens->write(t);
+	d->dst_shift++;
+}
+
+/* Pass a match to the expand stage */
+void fpga::put_match(struct fpga::tinf_data *d, unsigned int length, unsigned int offs)
+{
+#pragma HLS inline region
+
+	struct fpga::tinf_token t = {(unsigned short) length, (unsigned short) offs, 0};
+	d->tokens->write(t);
+	d->dst_shift += length;
+}
+
+/* -- Decoder state functions -- */
+
+/* Copy the block state from the state record */
+void fpga::load_state(struct fpga::tinf_data *d, const struct fpga::tinf_state *state)
+{
+#pragma HLS inline region
+
+	d->mode = state->mode;
+	d->last = state->last;
+	d->stored_len = state->stored_len;
+	d->match_len = state->match_len;
+	d->match_offs = state->match_offs;
+	d->hlit = state->hlit;
+	d->hdist = state->hdist;
+
+	if(d->mode == fpga::TINF_BLOCK_DYNAMIC)
+	{
+		load_state: for(unsigned int i = 0; i < d->hlit + d->hdist; ++i)
+		{
+		#pragma HLS PIPELINE
+			d->lengths[i] = state->lengths[i];
+		}
+	}
+}
+
+/* Copy the block state to the state record */
+void fpga::store_state(const struct fpga::tinf_data *d, struct fpga::tinf_state *state)
+{
+#pragma HLS inline region
+
+	state->mode = d->mode;
+	state->last = d->last;
+	state->stored_len = d->stored_len;
+	state->match_len = d->match_len;
+	state->match_offs = d->match_offs;
+	state->hlit = d->hlit;
+	state->hdist = d->hdist;
+
+	if(d->mode == fpga::TINF_BLOCK_DYNAMIC)
+	{
+		store_state: for(unsigned int i = 0; i < d->hlit + d->hdist; ++i)
+		{
+		#pragma HLS PIPELINE
+			state->lengths[i] = d->lengths[i];
+		}
+	}
 }
 
 /* -- Block inflate functions -- */
 
-/* Given a stream and two trees, inflate a block of data */
-int fpga::inflate_block_data(struct fpga::tinf_data *d, struct fpga::tinf_tree *lt, struct fpga::tinf_tree *dt)
+/* Given a stream and two lookup tables, inflate a block of data */
+template <int LROOT, int DROOT, bool SUB>
+int fpga::inflate_block_data(struct fpga::tinf_data *d, const struct fpga::tinf_entry *ltable, int lmax_sym,
+                                                        const struct fpga::tinf_entry *dtable, int dmax_sym)
 {
 #pragma HLS inline region
 
@@ -364,105 +714,158 @@ int fpga::inflate_block_data(struct fpga::tinf_data *d, struct fpga::tinf_tree *
 		1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
 	};
 
-	inflate_block_data: for(unsigned int j = 0; j < 65535; ++j)
+	/* Finish a match that was cut off by a full output buffer */
+	if (d->match_len > 0)
 	{
-        #pragma HLS PIPELINE
+		unsigned int room = d->dst_len - d->dst_shift;
+		unsigned int length = d->match_len < room ? d->match_len : room;
 
-		int sym = fpga::decode_symbol(d, lt);
+		if (d->match_offs > d->dst_shift + d->win_len) return fpga::TINF_DATA_ERROR;
 
-		// Check for overflow in bit reader
-		if (d->overflow) return fpga::TINF_DATA_ERROR;
+		fpga::put_match(d, length, d->match_offs);
 
-		if (sym < 256)
-		{
-			if (d->dest == d->dest_end) return fpga::TINF_BUF_ERROR;
+		d->match_len -= length;
 
-			*d->dest++ = sym;
+		if (d->match_len > 0) return fpga::TINF_SUSPEND;
+	}
 
-			d->dst_shift++;
-		}
-		else
-		{
-			int length, dist, offs;
-			int i;
+	inflate_block_data: for(;;)
+	{
+        #pragma HLS PIPELINE
 
-			// Check for end of block
-			if (sym == 256) return fpga::TINF_OK;
+		/* Symbol boundary: the block is resumed from here */
+		unsigned int src_shift_sym = d->src_shift;
+		unsigned long long tag_sym = d->tag;
+		int bitcount_sym = d->bitcount;
 
-			// Check sym is within range and distance tree is not empty
-			if (sym > lt->max_sym || sym - 257 > 28 || dt->max_sym == -1) return fpga::TINF_DATA_ERROR;
+		/* Enough bits for a length code, its extra bits and a distance code */
+		fpga::refill(d, 35);
+
+		int sym = fpga::decode_symbol<LROOT, SUB>(d, ltable);
+		int length = 0, dist = 0, offs = 0;
 
-			sym -= 257;
+		if (sym > 256)
+		{
+			// Check sym is within range and distance tree is not empty
+			if (sym > lmax_sym || sym - 257 > 28 || dmax_sym == -1)
+			{
+				if (d->overflow) goto suspend;
+				return fpga::TINF_DATA_ERROR;
+			}
 
 			// Possibly get more bits from length code
-			length = fpga::getbits_base(d, length_bits[sym], length_base[sym]);
-			dist = fpga::decode_symbol(d, dt);
+			length = fpga::getbits_base(d, length_bits[sym - 257], length_base[sym - 257]);
+			dist = fpga::decode_symbol<DROOT, SUB>(d, dtable);
 
 			// Check dist is within range
-			if (dist > dt->max_sym || dist > 29) return fpga::TINF_DATA_ERROR;
+			if (dist > dmax_sym || dist > 29)
+			{
+				if (d->overflow) goto suspend;
+				return fpga::TINF_DATA_ERROR;
+			}
 
 			// Possibly get more bits from distance code
 			offs = fpga::getbits_base(d, dist_bits[dist], dist_base[dist]);
+		}
+
+		// Symbol runs over the end of the input window
+		if (d->overflow) goto suspend;
+
+		if (sym < 256)
+		{
+			// Output full: resume with this literal
+			if (d->dst_shift == d->dst_len) goto suspend;
+
+			fpga::put_literal(d, sym);
+		}
+		else if (sym == 256)
+		{
+			// End of block
+			return fpga::TINF_OK;
+		}
+		else
+		{
+			unsigned int room = d->dst_len - d->dst_shift;
 
-			//if (offs > d->dest - d->dest_start) return fpga::TINF_DATA_ERROR;
-			//if (d->overflow) return fpga::TINF_DATA_ERROR;
-			//if (d->dest_end - d->dest < length) return TINF_BUF_ERROR;
+			if ((unsigned int) offs > d->dst_shift + d->win_len) return fpga::TINF_DATA_ERROR;
 
-			// Copy match
-			for (i = 0; i < length; ++i)
+			// Output full: resume with this match
+			if (room == 0) goto suspend;
+
+			// Copy match, keep what does not fit for the next run
+			if ((unsigned int) length > room)
 			{
-			#pragma HLS UNROLL factor=15
-			    d->dest[i] = d->dest[i - offs];
+				d->match_len = length - room;
+				d->match_offs = offs;
+				length = room;
 			}
 
-			d->dest += length;
-			d->dst_shift += length;
+			fpga::put_match(d, length, offs);
+
+			if (d->match_len > 0) return fpga::TINF_SUSPEND;
 		}
-	}
 
-	return fpga::TINF_OK;
+		continue;
+
+	suspend:
+		/* Roll back to the symbol boundary */
+		d->src_shift = src_shift_sym;
+		d->tag = tag_sym;
+		d->bitcount = bitcount_sym;
+		d->overflow = 0;
+
+		return fpga::TINF_SUSPEND;
+	}
 }
 
-/* Inflate an uncompressed block of data */
-int fpga::inflate_uncompressed_block(struct fpga::tinf_data *d)
+/* Read the header of an uncompressed block */
+int fpga::start_uncompressed_block(struct fpga::tinf_data *d)
 {
 #pragma HLS inline region
 
 	unsigned int length, invlength;
 
-	if (d->source_end - d->source < 4) return fpga::TINF_DATA_ERROR;
+	/* Skip to the next byte boundary */
+	fpga::getbits_no_refill(d, d->bitcount & 7);
 
 	/* Get length */
-	length = fpga::read_le16(d->source);
+	length = fpga::getbits(d, 16);
 
 	/* Get one's complement of length */
-	invlength = fpga::read_le16(d->source + 2);
+	invlength = fpga::getbits(d, 16);
+
+	if (d->overflow) return fpga::TINF_DATA_ERROR;
 
 	/* Check length */
 	if (length != (~invlength & 0x0000FFFF)) return fpga::TINF_DATA_ERROR;
 
-	d->source += 4;
-	d->src_shift += 4;
+	d->stored_len = length;
 
-	if (d->source_end - d->source < length) return fpga::TINF_DATA_ERROR;
+	return fpga::TINF_OK;
+}
+
+/* Inflate an uncompressed block of data */
+int fpga::inflate_uncompressed_block(struct fpga::tinf_data *d)
+{
+#pragma HLS inline region
 
-	if (d->dest_end - d->dest < length) return fpga::TINF_BUF_ERROR;
+	/* Copy as much as input and output allow, tag holds whole bytes only */
+	unsigned int length = d->stored_len;
+	unsigned int avail = (d->bitcount >> 3) + d->stage_bytes + d->bytes_left;
+
+	if (avail < length) length = avail;
+	if (d->dst_len - d->dst_shift < length) length = d->dst_len - d->dst_shift;
 
 	/* Copy block */
-	//while (length--)
-	for(int i = length; i > length; --i)
+	for(unsigned int i = 0; i < length; ++i)
 	{
-	#pragma HLS UNROLL factor=15
-	    *d->dest++ = *d->source++;
-	    d->src_shift++;
-	    d->dst_shift++;
+	#pragma HLS PIPELINE
+		fpga::put_literal(d, fpga::getbits(d, 8));
 	}
 
-	/* Make sure we start next block on a byte boundary */
-	d->tag = 0;
-	d->bitcount = 0;
+	d->stored_len -= length;
 
-	return fpga::TINF_OK;
+	return d->stored_len == 0 ? fpga::TINF_OK : fpga::TINF_SUSPEND;
 }
 
 /* Inflate a block of data compressed with fixed Huffman trees */
@@ -470,11 +873,9 @@ int fpga::inflate_fixed_block(struct fpga::tinf_data *d)
 {
 #pragma HLS inline region
 
-	/* Build fixed Huffman trees */
-	fpga::build_fixed_trees(&d->ltree, &d->dtree);
-
-	/* Decode block using fixed trees */
-	return fpga::inflate_block_data(d, &d->ltree, &d->dtree);
+	/* Decode block using the compile-time fixed tables */
+	return fpga::inflate_block_data<fpga::statictree::LITERAL_BITS, fpga::statictree::DISTANCE_BITS, false>(
+			d, fpga::statictree::fixed_literal::entry, 285, fpga::statictree::fixed_distance::entry, 29);
 }
 
 /* Inflate a block of data compressed with dynamic Huffman trees */
@@ -482,108 +883,562 @@ int fpga::inflate_dynamic_block(struct tinf_data *d)
 {
 #pragma HLS inline region
 
-	/* Decode trees from stream */
-	int res = fpga::decode_trees(d, &d->ltree, &d->dtree);
-	if(res != fpga::TINF_OK) return res;
-
 	/* Decode block using decoded trees */
-	return fpga::inflate_block_data(d, &d->ltree, &d->dtree);
+	return fpga::inflate_block_data<fpga::TINF_LTABLE_BITS, fpga::TINF_DTABLE_BITS, true>(
+			d, d->ltree.table, d->ltree.max_sym, d->dtree.table, d->dtree.max_sym);
 }
 
-/* Inflate stream from source to dest */
-extern "C" {
-void fpga_uncompress(unsigned char *dest,   unsigned int *dLen,
-                     unsigned char *source, unsigned int *sourceLen,
-                     unsigned int *tag, unsigned int *bitcount, unsigned int *overflow,
-		             int *bfinal, int *err)
+/* Read a block header, and the trees or length that follow it */
+int fpga::start_block(struct fpga::tinf_data *d)
 {
-#pragma HLS INTERFACE m_axi port=dest      offset=slave bundle=gmem
-#pragma HLS INTERFACE m_axi port=dLen      offset=slave bundle=gmem
+#pragma HLS inline region
 
-#pragma HLS INTERFACE m_axi port=source    offset=slave bundle=gmem
-#pragma HLS INTERFACE m_axi port=sourceLen offset=slave bundle=gmem
+	// Read final block flag
+	d->last = fpga::getbits(d, 1);
 
-#pragma HLS INTERFACE m_axi port=tag       offset=slave bundle=gmem
-#pragma HLS INTERFACE m_axi port=bitcount  offset=slave bundle=gmem
-#pragma HLS INTERFACE m_axi port=overflow  offset=slave bundle=gmem
+	// Read block type (2 bits)
+	unsigned int btype = fpga::getbits(d, 2);
 
-#pragma HLS INTERFACE m_axi port=bfinal    offset=slave bundle=gmem
-#pragma HLS INTERFACE m_axi port=err       offset=slave bundle=gmem
+	if(d->overflow) return fpga::TINF_DATA_ERROR;
 
-#pragma HLS INTERFACE s_axilite port=dest      bundle=control
-#pragma HLS INTERFACE s_axilite port=dLen      bundle=control
+	d->mode = btype + 1;
 
-#pragma HLS INTERFACE s_axilite port=source    bundle=control
-#pragma HLS INTERFACE s_axilite port=sourceLen bundle=control
+	switch(btype)
+	{
+	  case 0:
+		// Uncompressed block
+		return fpga::start_uncompressed_block(d);
+	  case 1:
+		// Block with fixed Huffman trees, nothing to read
+		return fpga::TINF_OK;
+	  case 2:
+		// Block with dynamic Huffman trees
+		return fpga::decode_trees(d, &d->ltree, &d->dtree);
+	  default:
+		return fpga::TINF_DATA_ERROR;
+	}
+}
+
+/* Continue inflating the current block */
+int fpga::inflate_block(struct fpga::tinf_data *d)
+{
+#pragma HLS inline region
 
-#pragma HLS INTERFACE s_axilite port=tag       bundle=control
-#pragma HLS INTERFACE s_axilite port=bitcount  bundle=control
-#pragma HLS INTERFACE s_axilite port=overflow  bundle=control
+	switch(d->mode)
+	{
+	  case fpga::TINF_BLOCK_STORED:
+		return fpga::inflate_uncompressed_block(d);
+	  case fpga::TINF_BLOCK_FIXED:
+		return fpga::inflate_fixed_block(d);
+	  case fpga::TINF_BLOCK_DYNAMIC:
+		return fpga::inflate_dynamic_block(d);
+	  default:
+		return fpga::TINF_DATA_ERROR;
+	}
+}
 
-#pragma HLS INTERFACE s_axilite port=bfinal    bundle=control
-#pragma HLS INTERFACE s_axilite port=err       bundle=control
+/* -- Dataflow stages -- */
 
-#pragma HLS INTERFACE s_axilite port=return bundle=control
-//#pragma HLS INTERFACE ap_ctrl_chain port=return bundle=control
+/* Stream the input window as 64 bit words */
+void fpga::unpack(const unsigned char *source, unsigned int sourceLen,
+                  fpga::stream<unsigned long long, fpga::TINF_WORD_DEPTH> &words)
+{
+	unpack: for(unsigned int i = 0; i < sourceLen; i += 8)
+	{
+	#pragma HLS PIPELINE
+		unsigned long long w = 0;
 
-	printf("source: %ld, sourcelen: %d, dest: %ld, destlen: %d, tag: %d, bitcount: %d, overflow: %d\n",
-			source, sourceLen[0], dest, dLen[0], tag[0], bitcount[0], overflow[0]);
+		if(sourceLen - i >= 8)
+		{
+			w = fpga::read_le64(source + i);
+		}
+		else
+		{
+			/* Last word, zero padded */
+			unpack_tail: for(unsigned int j = 0; j < sourceLen - i; ++j) w |= (unsigned long long) source[i + j] << (8 * j);
+		}
 
-	err[0] = fpga::TINF_OK;
+		words.write(w);
+	}
+}
 
+/* Decode the blocks of the input window into tokens */
+void fpga::decode(fpga::stream<unsigned long long, fpga::TINF_WORD_DEPTH> &words, unsigned int sourceLen,
+                  unsigned int dLen, struct fpga::tinf_state *state,
+                  fpga::stream<struct fpga::tinf_token, fpga::TINF_TOKEN_DEPTH> &tokens)
+{
     // Initialise data
     struct fpga::tinf_data d;
-	
-	d.source = source;
-	d.source_end = source + sourceLen[0];
-	d.sourceLen = sourceLen[0];
+
+	d.words = &words;
+	d.words_left = (sourceLen + 7) >> 3;
+	d.bytes_left = sourceLen;
+	d.stage = 0;
+	d.stage_bytes = 0;
 	d.src_shift = 0;
+	d.tag = state->tag;
+	d.bitcount = state->bitcount;
+	d.overflow = 0;
+
+	d.tokens = &tokens;
 	d.dst_shift = 0;
-	d.tag = tag[0];
-	d.bitcount = bitcount[0];
-	d.overflow = overflow[0];
+	d.dst_len = dLen;
+	d.win_len = state->win_len;
 
-	d.dest = dest;
-	d.dest_start = d.dest;
-	d.dest_end = d.dest + dLen[0];
+	fpga::load_state(&d, state);
 
-	// Read final block flag
-	bfinal[0] = fpga::getbits(&d, 1);
+	int err = fpga::TINF_OK;
+	int bfinal = state->bfinal;
+	unsigned int blocks = 0;
 
-	// Read block type (2 bits)
-	unsigned int btype = fpga::getbits(&d, 2);
+	// Trees of a dynamic block are rebuilt from its code lengths
+	if(d.mode == fpga::TINF_BLOCK_DYNAMIC) err = fpga::build_trees(&d, &d.ltree, &d.dtree);
 
-	printf("type: %d, final: %d\n", btype, bfinal[0]);
+	// Inflate blocks until the final one, stop when input or output runs out
+	inflate_blocks: while(!bfinal && err == fpga::TINF_OK)
+	{
+		if(d.mode == fpga::TINF_BLOCK_NONE)
+		{
+			// Checkpoint at the block boundary
+			unsigned int src_shift_block = d.src_shift;
+			unsigned long long tag_block = d.tag;
+			int bitcount_block = d.bitcount;
 
-	// Decompress block
-	switch(btype)
+			err = fpga::start_block(&d);
+
+			if(err != fpga::TINF_OK || d.overflow)
+			{
+				if(d.overflow)
+				{
+					// Block header runs over the input window: roll back, the host resumes here
+					d.src_shift = src_shift_block;
+					d.tag = tag_block;
+					d.bitcount = bitcount_block;
+					d.overflow = 0;
+					d.mode = fpga::TINF_BLOCK_NONE;
+					err = fpga::TINF_OK;
+				}
+				break;
+			}
+		}
+
+		err = fpga::inflate_block(&d);
+
+		if(err == fpga::TINF_SUSPEND)
+		{
+			// Input window exhausted or output full within the block
+			err = fpga::TINF_OK;
+			break;
+		}
+
+		if(err != fpga::TINF_OK) break;
+
+		d.mode = fpga::TINF_BLOCK_NONE;
+		bfinal = d.last;
+		++blocks;
+	}
+
+	// Words behind the stop position are not needed
+	drain: while(d.words_left > 0)
 	{
-	  case 0:
-		// Decompress uncompressed block
-		err[0] = fpga::inflate_uncompressed_block(&d);
-		break;
-	  case 1:
-		// Decompress block with fixed Huffman trees
-		err[0] = fpga::inflate_fixed_block(&d);
-		break;
-	  case 2:
-		// Decompress block with dynamic Huffman trees
-		err[0] = fpga::inflate_dynamic_block(&d);
-		break;
-	  default:
-		err[0] = fpga::TINF_DATA_ERROR;
-		break;
+	#pragma HLS PIPELINE
+		words.read();
+		d.words_left--;
 	}
 
-	//source = d.source;
-	sourceLen[0] -= d.src_shift;
-	tag[0] = d.tag;
-	bitcount[0] = d.bitcount;
-	overflow[0] = d.overflow;
+	struct fpga::tinf_token end = {0, 0, 1};
+	tokens.write(end);
+
+	// Hand back unused whole bytes, less than 8 bits stay in tag
+	fpga::rewind(&d);
+
+	fpga::store_state(&d, state);
+
+	state->win_len = d.win_len + d.dst_shift > fpga::TINF_WINDOW_SIZE ? fpga::TINF_WINDOW_SIZE : d.win_len + d.dst_shift;
+	state->tag = (unsigned int) d.tag;
+	state->bitcount = d.bitcount;
+	state->overflow = d.overflow;
+	state->bfinal = bfinal;
+	state->err = err;
+	state->src_used = d.src_shift;
+	state->dst_used = d.dst_shift;
+	state->blocks = blocks;
+}
+
+/* Expand tokens into the output, keep the window in history */
+void fpga::expand(fpga::stream<struct fpga::tinf_token, fpga::TINF_TOKEN_DEPTH> &tokens,
+                  unsigned char *dest, unsigned int dLen, struct fpga::tinf_history *history)
+{
+	// History of the last 32 KiB of output, kept on chip during the run
+	unsigned char window[fpga::TINF_WINDOW_SIZE];
+#pragma HLS RESOURCE variable=window core=RAM_2P_BRAM
+
+	unsigned int crc_tab[8][256];
+#pragma HLS ARRAY_PARTITION variable=crc_tab complete dim=1
+
+	struct fpga::tinf_output o;
+
+	o.dest_start = dest;
+	o.dest = dest;
+	o.dest_end = dest + dLen;
+	o.window = window;
+
+	load_window: for(unsigned int i = 0; i < fpga::TINF_WINDOW_SIZE; ++i)
+	{
+	#pragma HLS PIPELINE
+		window[i] = history->window[i];
+	}
+
+	expand: for(;;)
+	{
+	#pragma HLS PIPELINE
+		struct fpga::tinf_token t = tokens.read();
+
+		if(t.last) break;
+
+		if(t.length == 0) *o.dest++ = (unsigned char) t.dist;
+		else fpga::write_match(&o, t.length, t.dist);
+	}
+
+	fpga::update_window(&o);
+
+	unsigned int produced = o.dest - o.dest_start;
+
+	// CRC32 of the output of this run, a word per cycle
+	fpga::crc_tables(crc_tab);
+
+	unsigned int crc = history->crc ^ 0xFFFFFFFF;
+	unsigned int pos = 0;
+
+	crc_words: for(; pos + 8 <= produced; pos += 8)
+	{
+	#pragma HLS PIPELINE
+		crc = fpga::crc_word(crc_tab, crc, fpga::read_le64(dest + pos));
+	}
+
+	crc_tail: for(; pos < produced; ++pos)
+	{
+	#pragma HLS PIPELINE
+		crc = fpga::crc_byte(crc_tab, crc, dest[pos]);
+	}
+
+	history->crc = crc ^ 0xFFFFFFFF;
+	history->isize += produced;
+
+	// Oldest byte first, the newest one ends up at the end of history
+	store_window: for(unsigned int i = 0; i < fpga::TINF_WINDOW_SIZE; ++i)
+	{
+	#pragma HLS PIPELINE
+		history->window[i] = window[(produced + i) & (fpga::TINF_WINDOW_SIZE - 1)];
+	}
+}
+
+/* Write a whole word to a stream port */
+void fpga::write_packet(fpga::stream<fpga::packet, fpga::TINF_WORD_DEPTH> &s, unsigned long long data, unsigned int last)
+{
+#pragma HLS inline region
+
+	fpga::packet p;
+
+	p.data = data;
+	p.keep = 0xFF;
+	p.last = last;
+
+	s.write(p);
+}
+
+/* Pass the words of the input window on from the stream port */
+void fpga::unpack_stream(fpga::stream<fpga::packet, fpga::TINF_WORD_DEPTH> &source, unsigned int sourceLen,
+                         fpga::stream<unsigned long long, fpga::TINF_WORD_DEPTH> &words)
+{
+	unpack_stream: for(unsigned int i = 0; i < sourceLen; i += 8)
+	{
+	#pragma HLS PIPELINE
+		/* Bytes behind sourceLen are never loaded into the bit accumulator */
+		words.write((unsigned long long) source.read().data);
+	}
+}
+
+/* Expand tokens into segments of the output stream, keep the window in history */
+void fpga::expand_stream(fpga::stream<struct fpga::tinf_token, fpga::TINF_TOKEN_DEPTH> &tokens,
+                         fpga::stream<fpga::packet, fpga::TINF_WORD_DEPTH> &dest, unsigned int dLen, struct fpga::tinf_history *history)
+{
+	assert(dLen >= 16 && dLen % 8 == 0);
+
+	// History of the last 32 KiB of output, including the output of this run
+	unsigned char window[fpga::TINF_WINDOW_SIZE];
+#pragma HLS RESOURCE variable=window core=RAM_2P_BRAM
+
+	unsigned int crc_tab[8][256];
+#pragma HLS ARRAY_PARTITION variable=crc_tab complete dim=1
+
+	fpga::crc_tables(crc_tab);
+
+	load_window: for(unsigned int i = 0; i < fpga::TINF_WINDOW_SIZE; ++i)
+	{
+	#pragma HLS PIPELINE
+		window[i] = history->window[i];
+	}
+
+	unsigned int produced = 0;     /* window index of the next byte */
+	unsigned long long word = 0;   /* output bytes not yet written to dest */
+	unsigned int fill = 0;         /* number of bytes in word */
+	unsigned int seg = 0;          /* number of output bytes of the current segment */
+	unsigned int seg_len = dLen - 8;
+	unsigned int crc = history->crc ^ 0xFFFFFFFF;
+
+	expand_stream: for(;;)
+	{
+		struct fpga::tinf_token t = tokens.read();
+
+		if(t.last) break;
+
+		unsigned int length = t.length ? t.length : 1;
+
+		expand_bytes: for(unsigned int i = 0; i < length; ++i)
+		{
+		#pragma HLS PIPELINE
+			unsigned char b = t.length ? window[(produced - t.dist) & (fpga::TINF_WINDOW_SIZE - 1)] : (unsigned char) t.dist;
+
+			window[produced++ & (fpga::TINF_WINDOW_SIZE - 1)] = b;
+			word |= (unsigned long long) b << (8 * fill);
+
+			if(++fill == 8)
+			{
+				crc = fpga::crc_word(crc_tab, crc, word);
+				fpga::write_packet(dest, word, 0);
+				word = 0;
+				fill = 0;
+			}
+
+			// Segment full: close it with its trailer, words are whole here
+			if(++seg == seg_len)
+			{
+				fpga::write_packet(dest, seg, 1);
+				seg = 0;
+			}
+		}
+	}
+
+	// Last segment, zero padded, its trailer marks the end of the run
+	if(fill > 0) fpga::write_packet(dest, word, 0);
+	fpga::write_packet(dest, seg | (1ULL << 32), 1);
+
+	crc_tail: for(unsigned int i = 0; i < fill; ++i)
+	{
+	#pragma HLS PIPELINE
+		crc = fpga::crc_byte(crc_tab, crc, (unsigned char) (word >> (8 * i)));
+	}
+
+	history->crc = crc ^ 0xFFFFFFFF;
+	history->isize += produced;
+
+	store_window: for(unsigned int i = 0; i < fpga::TINF_WINDOW_SIZE; ++i)
+	{
+	#pragma HLS PIPELINE
+		history->window[i] = window[(produced + i) & (fpga::TINF_WINDOW_SIZE - 1)];
+	}
+}
+
+/* Expand tokens into the window only, keep the window in history */
+void fpga::expand_verify(fpga::stream<struct fpga::tinf_token, fpga::TINF_TOKEN_DEPTH> &tokens,
+                         struct fpga::tinf_history *history)
+{
+	// History of the last 32 KiB of output, including the output of this run
+	unsigned char window[fpga::TINF_WINDOW_SIZE];
+#pragma HLS RESOURCE variable=window core=RAM_2P_BRAM
+
+	unsigned int crc_tab[8][256];
+#pragma HLS ARRAY_PARTITION variable=crc_tab complete dim=1
+
+	fpga::crc_tables(crc_tab);
+
+	load_window: for(unsigned int i = 0; i < fpga::TINF_WINDOW_SIZE; ++i)
+	{
+	#pragma HLS PIPELINE
+		window[i] = history->window[i];
+	}
+
+	unsigned int produced = 0;     /* window index of the next byte */
+	unsigned long long word = 0;   /* output bytes not yet accounted in crc */
+	unsigned int fill = 0;         /* number of bytes in word */
+	unsigned int crc = history->crc ^ 0xFFFFFFFF;
+
+	expand_verify: for(;;)
+	{
+		struct fpga::tinf_token t = tokens.read();
+
+		if(t.last) break;
+
+		unsigned int length = t.length ? t.length : 1;
+
+		expand_bytes: for(unsigned int i = 0; i < length; ++i)
+		{
+		#pragma HLS PIPELINE
+			unsigned char b = t.length ? window[(produced - t.dist) & (fpga::TINF_WINDOW_SIZE - 1)] : (unsigned char) t.dist;
+
+			window[produced++ & (fpga::TINF_WINDOW_SIZE - 1)] = b;
+			word |= (unsigned long long) b << (8 * fill);
+
+			if(++fill == 8)
+			{
+				crc = fpga::crc_word(crc_tab, crc, word);
+				word = 0;
+				fill = 0;
+			}
+		}
+	}
+
+	crc_tail: for(unsigned int i = 0; i < fill; ++i)
+	{
+	#pragma HLS PIPELINE
+		crc = fpga::crc_byte(crc_tab, crc, (unsigned char) (word >> (8 * i)));
+	}
+
+	history->crc = crc ^ 0xFFFFFFFF;
+	history->isize += produced;
+
+	store_window: for(unsigned int i = 0; i < fpga::TINF_WINDOW_SIZE; ++i)
+	{
+	#pragma HLS PIPELINE
+		history->window[i] = window[(produced + i) & (fpga::TINF_WINDOW_SIZE - 1)];
+	}
+}
+
+/* Inflate stream from source to dest */
+extern "C" {
+void fpga_uncompress(unsigned char *dest,   unsigned int dLen,
+                     unsigned char *source, unsigned int sourceLen,
+                     struct fpga::tinf_state *state,
+                     struct fpga::tinf_history *history)
+{
+#pragma HLS INTERFACE m_axi port=dest      offset=slave bundle=gmem
+#pragma HLS INTERFACE m_axi port=source    offset=slave bundle=gmem
+#pragma HLS INTERFACE m_axi port=state     offset=slave bundle=gmem
+#pragma HLS INTERFACE m_axi port=history   offset=slave bundle=gmem
+
+#pragma HLS INTERFACE s_axilite port=dest      bundle=control
+#pragma HLS INTERFACE s_axilite port=dLen      bundle=control
+
+#pragma HLS INTERFACE s_axilite port=source    bundle=control
+#pragma HLS INTERFACE s_axilite port=sourceLen bundle=control
+
+#pragma HLS INTERFACE s_axilite port=state     bundle=control
+#pragma HLS INTERFACE s_axilite port=history   bundle=control
+
+#pragma HLS INTERFACE s_axilite port=return bundle=control
+//#pragma HLS INTERFACE ap_ctrl_chain port=return bundle=control
+
+#pragma HLS DATAFLOW
+
+	fpga::stream<unsigned long long, fpga::TINF_WORD_DEPTH> words;
+	fpga::stream<struct fpga::tinf_token, fpga::TINF_TOKEN_DEPTH> tokens;
+#pragma HLS STREAM variable=words  depth=64
+#pragma HLS STREAM variable=tokens depth=1024
+
+#ifdef __SYNTHESIS__
+	fpga::unpack(source, sourceLen, words);
+	fpga::decode(words, sourceLen, dLen, state, tokens);
+	fpga::expand(tokens, dest, dLen, history);
+#else
+	// CPU model: one thread per stage
+	std::thread unpack(fpga::unpack, source, sourceLen, std::ref(words));
+	std::thread expand(fpga::expand, std::ref(tokens), dest, dLen, history);
+
+	fpga::decode(words, sourceLen, dLen, state, tokens);
+
+	unpack.join();
+	expand.join();
+#endif
+}}
+
+/* Inflate a stream port into a stream port */
+extern "C" {
+void fpga_uncompress_stream(fpga::stream<fpga::packet, fpga::TINF_WORD_DEPTH> &dest, unsigned int dLen,
+                            fpga::stream<fpga::packet, fpga::TINF_WORD_DEPTH> &source, unsigned int sourceLen,
+                            struct fpga::tinf_state *state,
+                            struct fpga::tinf_history *history)
+{
+#pragma HLS INTERFACE axis port=dest
+#pragma HLS INTERFACE axis port=source
+
+#pragma HLS INTERFACE m_axi port=state     offset=slave bundle=gmem
+#pragma HLS INTERFACE m_axi port=history   offset=slave bundle=gmem
+
+#pragma HLS INTERFACE s_axilite port=dLen      bundle=control
+#pragma HLS INTERFACE s_axilite port=sourceLen bundle=control
+
+#pragma HLS INTERFACE s_axilite port=state     bundle=control
+#pragma HLS INTERFACE s_axilite port=history   bundle=control
+
+#pragma HLS INTERFACE s_axilite port=return bundle=control
+
+#pragma HLS DATAFLOW
+
+	fpga::stream<unsigned long long, fpga::TINF_WORD_DEPTH> words;
+	fpga::stream<struct fpga::tinf_token, fpga::TINF_TOKEN_DEPTH> tokens;
+#pragma HLS STREAM variable=words  depth=64
+#pragma HLS STREAM variable=tokens depth=1024
+
+	// No output limit, the output leaves the kernel segment by segment
+	unsigned int dMax = UINT_MAX;
+
+#ifdef __SYNTHESIS__
+	fpga::unpack_stream(source, sourceLen, words);
+	fpga::decode(words, sourceLen, dMax, state, tokens);
+	fpga::expand_stream(tokens, dest, dLen, history);
+#else
+	// CPU model: one thread per stage
+	std::thread unpack(fpga::unpack_stream, std::ref(source), sourceLen, std::ref(words));
+	std::thread expand(fpga::expand_stream, std::ref(tokens), std::ref(dest), dLen, history);
+
+	fpga::decode(words, sourceLen, dMax, state, tokens);
+
+	unpack.join();
+	expand.join();
+#endif
+}}
+
+/* Inflate stream from source into a discard sink */
+extern "C" {
+void fpga_verify(unsigned char *source, unsigned int sourceLen,
+                 struct fpga::tinf_state *state,
+                 struct fpga::tinf_history *history)
+{
+#pragma HLS INTERFACE m_axi port=source    offset=slave bundle=gmem
+#pragma HLS INTERFACE m_axi port=state     offset=slave bundle=gmem
+#pragma HLS INTERFACE m_axi port=history   offset=slave bundle=gmem
+
+#pragma HLS INTERFACE s_axilite port=source    bundle=control
+#pragma HLS INTERFACE s_axilite port=sourceLen bundle=control
+
+#pragma HLS INTERFACE s_axilite port=state     bundle=control
+#pragma HLS INTERFACE s_axilite port=history   bundle=control
+
+#pragma HLS INTERFACE s_axilite port=return bundle=control
+
+#pragma HLS DATAFLOW
+
+	fpga::stream<unsigned long long, fpga::TINF_WORD_DEPTH> words;
+	fpga::stream<struct fpga::tinf_token, fpga::TINF_TOKEN_DEPTH> tokens;
+#pragma HLS STREAM variable=words  depth=64
+#pragma HLS STREAM variable=tokens depth=1024
+
+	// No output buffer, a run ends with the input window or the final block
+	unsigned int dMax = UINT_MAX;
+
+#ifdef __SYNTHESIS__
+	fpga::unpack(source, sourceLen, words);
+	fpga::decode(words, sourceLen, dMax, state, tokens);
+	fpga::expand_verify(tokens, history);
+#else
+	// CPU model: one thread per stage
+	std::thread unpack(fpga::unpack, source, sourceLen, std::ref(words));
+	std::thread expand(fpga::expand_verify, std::ref(tokens), history);
 
-	//dest = d.dest;
-	dLen[0] -= d.dst_shift;
+	fpga::decode(words, sourceLen, dMax, state, tokens);
 
-	printf("source: %ld, sourcelen: %d, dest: %ld, destlen: %d, shift: %d %d, tag: %d, bitcount: %d, overflow: %d\n",
-			source, sourceLen[0], dest, dLen[0], d.src_shift, d.dst_shift, tag[0], bitcount[0], overflow[0]);
+	unpack.join();
+	expand.join();
+#endif
 }}
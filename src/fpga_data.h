@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <stdio.h>
+#include "stream.h"
 
 #if defined(UINT_MAX) && (UINT_MAX) < 0xFFFFFFFFUL
 #  error "tinf requires unsigned int to be at least 32-bit"
@@ -11,18 +12,12 @@
 
 namespace fpga {
   
-static const unsigned int tinf_crc32tab[16] = {
-	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190,
-	0x6B6B51F4, 0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344,
-	0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278,
-	0xBDBDF21C
-};
-
 /***************************************************************//**
 * Enum type that maps error codes                                  
 ********************************************************************/
 typedef enum {
 	TINF_OK          =  0, /**< Success */
+	TINF_SUSPEND     =  1, /**< Block not finished: input window exhausted or output buffer full (kernel internal) */
 	TINF_DATA_ERROR  = -3, /**< Input error */
 	TINF_BUF_ERROR   = -5, /**< Not enough room for output */
 	TINF_FILE_ERROR  = -7  /**< Not enoug diskspace or wrong file permissions */
@@ -40,6 +35,60 @@ typedef enum {
     FCOMMENT = 16  /**< a zero-terminated file comment is present */
 } tinf_gzip_flag;
 
+/***************************************************************//**
+* Enum type that maps the type of the block the decoder is in.
+* A zeroed state is at a block boundary.
+********************************************************************/
+typedef enum {
+	TINF_BLOCK_NONE    = 0, /**< at a block boundary, the next block header is read next */
+	TINF_BLOCK_STORED  = 1, /**< within an uncompressed block (BTYPE=0) */
+	TINF_BLOCK_FIXED   = 2, /**< within a block with fixed Huffman trees (BTYPE=1) */
+	TINF_BLOCK_DYNAMIC = 3  /**< within a block with dynamic Huffman trees (BTYPE=2) */
+} tinf_block_mode;
+
+/***************************************************************//**
+* Number of index bits of the primary lookup table for
+* literal/length (and fixed) alphabets
+********************************************************************/
+static const int TINF_LTABLE_BITS = 9;
+
+/***************************************************************//**
+* Number of index bits of the primary lookup table for distance
+* and code length alphabets
+********************************************************************/
+static const int TINF_DTABLE_BITS = 6;
+
+/***************************************************************//**
+* Maximum number of lookup table entries (primary table plus all
+* sub-tables). 852 is the upper bound for 286 literal/length codes
+* with a 9 bit primary table and 15 bit codes, which also covers 30
+* distance codes with a 6 bit primary table (592), see zlib's
+* enough.c.
+********************************************************************/
+static const int TINF_TABLE_SIZE = 852;
+
+/***************************************************************//**
+* Size of the history window in bytes (32 KiB, the largest distance
+* allowed by rfc1951). Must be a power of two.
+********************************************************************/
+static const unsigned int TINF_WINDOW_SIZE = 32768;
+
+/***************************************************************//**
+* Depth of the FIFOs between the dataflow stages, keep in sync with
+* the STREAM pragmas in fpga_uncompress
+********************************************************************/
+static const unsigned int TINF_WORD_DEPTH  = 64;
+static const unsigned int TINF_TOKEN_DEPTH = 1024;
+
+/***************************************************************//**
+* Entry of a Huffman lookup table                                  
+********************************************************************/
+struct tinf_entry {
+	unsigned short sym;  /**< symbol, or offset of sub-table if sub is 1 */
+	unsigned char  bits; /**< code length, or index bits of sub-table if sub is 1 */
+	unsigned char  sub;  /**< 1 if the entry links to a sub-table */
+};
+
 /***************************************************************//**
 * Data structure that contains a Huffman tree                      
 ********************************************************************/
@@ -47,30 +96,99 @@ struct tinf_tree {
 	unsigned short counts[16];   /* Number of codes with a given length */
 	unsigned short symbols[288]; /* Symbols sorted by code */
 	int max_sym;
+
+	struct tinf_entry table[TINF_TABLE_SIZE]; /**< primary table followed by sub-tables */
+};
+
+/***************************************************************//**
+* Literal or match passed from the decode stage to the expand stage
+********************************************************************/
+struct tinf_token {
+	unsigned short length; /**< match length, 0 for a literal */
+	unsigned short dist;   /**< match distance, or the literal */
+	unsigned char  last;   /**< 1 on the token that ends the run */
 };
 
 /***************************************************************//**
-* Data structure that contains information on compressed and       
-* uncompressed files                                               
+* Data structure of the decode stage that contains information on
+* the compressed input and the amount of output
 ********************************************************************/
 struct tinf_data {
-    unsigned char *source;     /**< pointer to current position in input array */
-    unsigned char *source_end; /**< pointer to end of input array */
-    unsigned int sourceLen;    /**< length of th the data located at *source */
-    unsigned int src_shift;    /**< number of source pointer shifts */
-    unsigned int dst_shift;    /**< number of output pointer shifts */
-    unsigned int tag;
-    int bitcount;
-    int overflow;
+    stream<unsigned long long, TINF_WORD_DEPTH> *words; /**< input words from the unpack stage */
+    unsigned int words_left;   /**< number of words not yet read from words */
+    unsigned int bytes_left;   /**< number of input bytes in these words */
+    unsigned long long stage;  /**< bytes of the last word not yet loaded into tag */
+    unsigned int stage_bytes;  /**< number of bytes in stage */
+    unsigned int src_shift;    /**< number of input bytes loaded into tag */
+    unsigned long long tag;    /**< bit accumulator, holds up to 64 bits of source */
+    int bitcount;              /**< number of valid bits in tag */
+    int overflow;              /**< 1 if more bits were consumed than source holds */
 
-    unsigned char *dest_start; /**< pointer to begin of output array */
-    unsigned char *dest;       /**< pointer to current position in output array */
-    unsigned char *dest_end;   /**< pointer to end of output array */
+    stream<struct tinf_token, TINF_TOKEN_DEPTH> *tokens; /**< output tokens to the expand stage */
+    unsigned int dst_shift;    /**< number of output bytes passed as tokens */
+    unsigned int dst_len;      /**< length of the output buffer */
+    unsigned int win_len;      /**< number of valid bytes of history in front of the output */
+
+    unsigned int mode;         /**< tinf_block_mode of the current block */
+    unsigned int last;         /**< 1 if the current block is the final one */
+    unsigned int stored_len;   /**< remaining bytes of an uncompressed block */
+    unsigned int match_len;    /**< remaining bytes of a match cut off by a full output */
+    unsigned int match_offs;   /**< distance of that match */
+    unsigned int hlit;         /**< number of literal/length code lengths */
+    unsigned int hdist;        /**< number of distance code lengths */
+    unsigned char lengths[288 + 32]; /**< code lengths of the dynamic trees */
 
     struct tinf_tree ltree;    /**< Literal/length tree */
     struct tinf_tree dtree;    /**< Distance tree */
 };
+
+/***************************************************************//**
+* Data structure of the expand stage that contains the output
+********************************************************************/
+struct tinf_output {
+    unsigned char *dest_start; /**< pointer to begin of output array */
+    unsigned char *dest;       /**< pointer to current position in output array */
+    unsigned char *dest_end;   /**< pointer to end of output array */
+    unsigned char *window;     /**< ring of the last TINF_WINDOW_SIZE bytes, dest_start maps to index 0 */
+};
  
+/***************************************************************//**
+* Decoder state that persists in global device memory between kernel
+* runs. The host reads it back after every run.
+********************************************************************/
+struct tinf_state {
+    unsigned int tag;      /**< unconsumed bits of the last partially read input byte */
+    unsigned int bitcount; /**< number of valid bits in tag (less than 8) */
+    unsigned int overflow; /**< 1 if the kernel consumed bits behind the input */
+    int bfinal;            /**< 1 after the final block has been inflated */
+    int err;               /**< TINF_BUF_ERROR if a single block does not fit into the output, TINF_DATA_ERROR if the data is corrupted, TINF_OK else */
+    unsigned int src_used; /**< number of input bytes consumed by the last run */
+    unsigned int dst_used; /**< number of output bytes written to dest by the last run */
+    unsigned int blocks;   /**< number of blocks finished by the last run */
+
+    unsigned int mode;       /**< tinf_block_mode of the block to be continued */
+    unsigned int last;       /**< 1 if that block is the final one */
+    unsigned int stored_len; /**< remaining bytes of an uncompressed block */
+    unsigned int match_len;  /**< remaining bytes of a match cut off by a full output */
+    unsigned int match_offs; /**< distance of that match */
+    unsigned int hlit;       /**< number of literal/length code lengths */
+    unsigned int hdist;      /**< number of distance code lengths */
+    unsigned char lengths[288 + 32]; /**< code lengths the dynamic trees are rebuilt from */
+
+    unsigned int win_len;    /**< number of valid bytes at the end of the history buffer */
+};
+
+/***************************************************************//**
+* Record of the expand stage that persists in global device memory
+* between kernel runs. The host zeroes it before the first run and
+* reads crc and isize back after the final one.
+********************************************************************/
+struct tinf_history {
+    unsigned char window[TINF_WINDOW_SIZE]; /**< last 32 KiB of output, the newest byte at the end */
+    unsigned int crc;   /**< CRC32 of the output of all runs */
+    unsigned int isize; /**< length of the output of all runs modulo 2^32 */
+};
+
 /***************************************************************//**
 * \brief Reads 16 bit and converts to unsigned integer             
 *                                                                  
@@ -81,16 +199,49 @@ struct tinf_data {
 * @param *p pointer to data
 ********************************************************************/
 unsigned int read_le16(const unsigned char *p);
-  
+
 /***************************************************************//**
-* \brief Builds a fixed Huffman literal tree and a dynamic 
-* distance tree.  
+* \brief Reads 64 bit and converts to unsigned long long
 *
-* @param *lt literal tree  
-* @param *dt distance tree             
+* The function reads exactly 8 bytes from right to left. The
+* function may return a segmentation fault if the array is to short.
+*
+* @param *p pointer to data
 ********************************************************************/
-void build_fixed_trees(struct tinf_tree *lt, struct tinf_tree *dt);
+inline unsigned long long read_le64(const unsigned char *p)
+{
+#pragma HLS inline
+
+	return ((unsigned long long) p[0])
+	     | ((unsigned long long) p[1] <<  8)
+	     | ((unsigned long long) p[2] << 16)
+	     | ((unsigned long long) p[3] << 24)
+	     | ((unsigned long long) p[4] << 32)
+	     | ((unsigned long long) p[5] << 40)
+	     | ((unsigned long long) p[6] << 48)
+	     | ((unsigned long long) p[7] << 56);
+}
 
+/***************************************************************//**
+* \brief Writes an unsigned long long as 8 bytes from right to left
+*
+* @param *p pointer to data
+* @param w value to be written
+********************************************************************/
+inline void write_le64(unsigned char *p, unsigned long long w)
+{
+#pragma HLS inline
+
+	p[0] = (unsigned char) (w);
+	p[1] = (unsigned char) (w >>  8);
+	p[2] = (unsigned char) (w >> 16);
+	p[3] = (unsigned char) (w >> 24);
+	p[4] = (unsigned char) (w >> 32);
+	p[5] = (unsigned char) (w >> 40);
+	p[6] = (unsigned char) (w >> 48);
+	p[7] = (unsigned char) (w >> 56);
+}
+  
 /***************************************************************//**
 * \brief Get a number of bits of an array containing lengths.
 *
@@ -100,10 +251,49 @@ void build_fixed_trees(struct tinf_tree *lt, struct tinf_tree *dt);
 ********************************************************************/
 int build_tree(struct tinf_tree *t, const unsigned char *lengths, unsigned int num);
 
+/***************************************************************//**
+* \brief Builds the multi-bit lookup table of a tree from its
+* counts and symbols arrays.
+*
+* Codes of up to root bits are resolved by a single lookup in the
+* primary table, longer codes link to a sub-table that is indexed
+* by the remaining bits.
+*
+* @param *t Huffman tree with valid counts and symbols
+* @param root number of index bits of the primary table
+********************************************************************/
+void build_table(struct tinf_tree *t, int root);
+
+/***************************************************************//**
+* \brief Ensures that at least num bits are available in the bit
+* accumulator.
+*
+* The accumulator is topped up to 56 or more bits with whole bytes
+* of the staged word and, if they run short, of the next word of
+* the input stream, so up to 56 bits can be peeked after one refill.
+* Bits behind the end of source read as zero, overflow is flagged
+* when they are consumed.
+*
+* @param num number of bits needed (at most 56)
+********************************************************************/
 int refill(struct tinf_data *d, int num);
 
+/***************************************************************//**
+* \brief Removes num bits from the bit accumulator and returns them
+* without loading new data. Sets overflow if less than num bits are
+* available.
+*
+* @param num number of bits (at most 32)
+********************************************************************/
 unsigned int getbits_no_refill(struct tinf_data *d, int num);
 
+/***************************************************************//**
+* \brief Returns all whole, unconsumed bytes of the bit accumulator
+* to source, such that less than 8 bits remain in tag. Used before
+* the state is handed to the host.
+********************************************************************/
+void rewind(struct tinf_data *d);
+
 /***************************************************************//**
 * \brief Get a number of bits abd returns   ???
 *
@@ -120,9 +310,15 @@ unsigned int getbits(struct tinf_data *d, int num);
 unsigned int getbits_base(struct tinf_data *d, int num, int base);
 
 /***************************************************************//**
-* \brief Decodes a symbol. Returns a tinf_error_code.
+* \brief Decodes a symbol with at most two table lookups and
+* returns it. Bits are peeked once and consumed by code length.
+*
+* @tparam ROOT index bits of the primary table
+* @tparam SUB false if the table is known to have no sub-tables
+* @param *table lookup table of the tree
 ********************************************************************/
-int decode_symbol(struct tinf_data *d, const struct tinf_tree *t);
+template <int ROOT, bool SUB>
+int decode_symbol(struct tinf_data *d, const struct tinf_entry *table);
 
 /***************************************************************//**
 * \brief Decodes a dynamic literal tree and a dynamic distance
@@ -134,23 +330,168 @@ int decode_symbol(struct tinf_data *d, const struct tinf_tree *t);
 int decode_trees(struct tinf_data *d, struct tinf_tree *lt, struct tinf_tree *dt);
 
 /***************************************************************//**
-* \brief Inflates a block of data given a literal tree and a 
-* distance tree. Returns a tinf_error_code.  
+* \brief Builds the dynamic trees from the code lengths kept in d
+* (lengths, hlit, hdist). Returns a tinf_error_code.
 *
 * @param *lt literal tree  
-* @param *dt distance tree                                     
+* @param *dt distance tree
 ********************************************************************/
-int inflate_block_data(struct tinf_data *d, struct tinf_tree *lt, struct tinf_tree *dt);
+int build_trees(struct tinf_data *d, struct tinf_tree *lt, struct tinf_tree *dt);
 
 /***************************************************************//**
-* \brief Inflate an uncompressed block of data.                    
+* \brief Copies the block state (mode, pending lengths and code
+* lengths) from the state record into d
+********************************************************************/
+void load_state(struct tinf_data *d, const struct tinf_state *state);
+
+/***************************************************************//**
+* \brief Copies the block state of d into the state record
+********************************************************************/
+void store_state(const struct tinf_data *d, struct tinf_state *state);
+
+/***************************************************************//**
+* \brief Copies as many whole chunks of W bytes of a match as
+* possible and returns the number of bytes copied. The distance
+* must be at least W, so that no chunk overlaps its source.
+*
+* @tparam W chunk size in bytes (multiple of 8)
+* @param *dst first byte of the match in the output
+* @param length length of the match
+* @param offs distance of the match
+********************************************************************/
+template <unsigned int W>
+unsigned int copy_wide(unsigned char *dst, unsigned int length, unsigned int offs);
+
+/***************************************************************//**
+* \brief Copies a match of length bytes from offs bytes back.
+*
+* Distances of 8 or more are copied in chunks of 64, 16 and 8 bytes,
+* shorter distances replicate an 8 byte pattern and a distance of 1
+* fills with a single byte value. With 8 or more bytes of room
+* behind the match, the last chunk may run over its end instead of
+* finishing byte by byte. The caller has to check that the source
+* lies within the output and that room is at least length.
+*
+* @param *dst first byte of the match in the output
+* @param length length of the match
+* @param offs distance of the match
+* @param room number of bytes that may be written at dst
+********************************************************************/
+void copy_match(unsigned char *dst, unsigned int length, unsigned int offs, unsigned int room);
+
+/***************************************************************//**
+* \brief Copies the part of a match that lies in front of the output
+* chunk from the window and returns the number of bytes copied.
+*
+* @param length length of the match
+* @param offs distance of the match
+********************************************************************/
+unsigned int copy_history(struct tinf_output *o, unsigned int length, unsigned int offs);
+
+/***************************************************************//**
+* \brief Writes a match to the output and advances it. The source
+* may lie in the window, in the output chunk or in both. The decode
+* stage has checked that offs reaches no further back than the
+* window and that the match fits.
+*
+* @param length length of the match
+* @param offs distance of the match
+********************************************************************/
+void write_match(struct tinf_output *o, unsigned int length, unsigned int offs);
+
+/***************************************************************//**
+* \brief Appends the output of the current run to the window
+********************************************************************/
+void update_window(struct tinf_output *o);
+
+/***************************************************************//**
+* \brief Fills the slice-by-8 tables of the CRC32 polynomial
+*
+* @param tab tables, tab[0] is the byte-wise table
+********************************************************************/
+void crc_tables(unsigned int tab[8][256]);
+
+/***************************************************************//**
+* \brief Updates the inverted CRC32 register with a byte
+********************************************************************/
+unsigned int crc_byte(const unsigned int tab[8][256], unsigned int crc, unsigned char b);
+
+/***************************************************************//**
+* \brief Updates the inverted CRC32 register with eight bytes, the
+* first one in the low bits of w, by eight parallel table lookups
+********************************************************************/
+unsigned int crc_word(const unsigned int tab[8][256], unsigned int crc, unsigned long long w);
+
+/***************************************************************//**
+* \brief Passes a literal to the expand stage
+********************************************************************/
+void put_literal(struct tinf_data *d, unsigned int lit);
+
+/***************************************************************//**
+* \brief Passes a match to the expand stage
+*
+* @param length length of the match
+* @param offs distance of the match
+********************************************************************/
+void put_match(struct tinf_data *d, unsigned int length, unsigned int offs);
+
+/***************************************************************//**
+* \brief Inflates a block of data given a literal table and a 
+* distance table. Returns a tinf_error_code.  
+*
+* The decoder is specialized at compile time, such that fixed
+* blocks and dynamic blocks run separate code paths. A pending
+* match is finished first. If a symbol runs over the end of the
+* input window or does not fit into the output, the stream is
+* rolled back to the symbol and TINF_SUSPEND is returned. A match
+* that only partly fits is cut, the rest is kept in match_len.
+*
+* @tparam LROOT index bits of the primary literal/length table
+* @tparam DROOT index bits of the primary distance table
+* @tparam SUB false if the tables are known to have no sub-tables
+* @param *ltable literal/length table
+* @param lmax_sym largest literal/length symbol with a code
+* @param *dtable distance table
+* @param dmax_sym largest distance symbol with a code (-1 if empty)
+********************************************************************/
+template <int LROOT, int DROOT, bool SUB>
+int inflate_block_data(struct tinf_data *d, const struct tinf_entry *ltable, int lmax_sym,
+                                            const struct tinf_entry *dtable, int dmax_sym);
+
+/***************************************************************//**
+* \brief Reads the header of the next block, and its length or
+* dynamic trees, and sets mode and last. Returns a tinf_error_code,
+* overflow is set if the header runs over the input window.
+********************************************************************/
+int start_block(struct tinf_data *d);
+
+/***************************************************************//**
+* \brief Continues inflating the current block. Returns TINF_OK
+* when the block is finished, TINF_SUSPEND if input or output ran
+* out within the block, else a tinf_error_code.
+********************************************************************/
+int inflate_block(struct tinf_data *d);
+
+/***************************************************************//**
+* \brief Skips to the next byte boundary and reads LEN and NLEN of
+* an uncompressed block.
 * Returns a tinf_error_code.                                       
 ********************************************************************/
+int start_uncompressed_block(struct tinf_data *d);
+
+/***************************************************************//**
+* \brief Inflate an uncompressed block of data as far as input and
+* output allow. Returns TINF_OK when the block is finished, else
+* TINF_SUSPEND.
+********************************************************************/
 int inflate_uncompressed_block(struct tinf_data *d);
 
 /***************************************************************//**
 * \brief Inflate a block of data compressed with fixed             
 * Huffman trees. Returns a tinf_error_code.                        
+*
+* The block is decoded through the compile-time tables in
+* statictree.h, no trees are built.
 ********************************************************************/
 int inflate_fixed_block(struct tinf_data *d);
 
@@ -160,39 +501,186 @@ int inflate_fixed_block(struct tinf_data *d);
 ********************************************************************/
 int inflate_dynamic_block(struct tinf_data *d);
 
+/***************************************************************//**
+* \brief Unpack stage: streams the input window as little endian
+* 64 bit words, the last word is zero padded.
+*
+* @param *source pointer to begin of input window
+* @param sourceLen length of the input window
+* @param words output stream
+********************************************************************/
+void unpack(const unsigned char *source, unsigned int sourceLen,
+            stream<unsigned long long, TINF_WORD_DEPTH> &words);
+
+/***************************************************************//**
+* \brief Decode stage: inflates blocks from the input words into
+* literal and match tokens until the final block, the end of the
+* input window or a full output, and updates the state record.
+* Ends the token stream with a token with last set.
+*
+* @param words input stream of the unpack stage
+* @param sourceLen length of the input window
+* @param dLen length of the output buffer
+* @param *state resumable decoder state, see tinf_state
+* @param tokens output stream
+********************************************************************/
+void decode(stream<unsigned long long, TINF_WORD_DEPTH> &words, unsigned int sourceLen,
+            unsigned int dLen, struct tinf_state *state,
+            stream<struct tinf_token, TINF_TOKEN_DEPTH> &tokens);
+
+/***************************************************************//**
+* \brief Expand stage: writes literals and copies matches to the
+* output. Matches reaching in front of the output are read from the
+* window, which is loaded from history at the start of the run and
+* written back at its end. Updates the CRC32 and the length of the
+* output in history.
+*
+* @param tokens input stream of the decode stage
+* @param *dest pointer to begin of output buffer
+* @param dLen length of the output buffer
+* @param *history window, CRC32 and length of the output, see tinf_history
+********************************************************************/
+void expand(stream<struct tinf_token, TINF_TOKEN_DEPTH> &tokens,
+            unsigned char *dest, unsigned int dLen, struct tinf_history *history);
+
+/***************************************************************//**
+* \brief Writes a whole 64 bit word to an AXI4-Stream port
+*
+* @param s output stream
+* @param data eight bytes, the first one in the low bits
+* @param last 1 on the last beat of a transfer
+********************************************************************/
+void write_packet(stream<packet, TINF_WORD_DEPTH> &s, unsigned long long data, unsigned int last);
+
+/***************************************************************//**
+* \brief Unpack stage of the streaming kernel: passes the words of
+* the input window on from the AXI4-Stream port.
+*
+* @param source input port, sourceLen bytes
+* @param sourceLen length of the input window
+* @param words output stream
+********************************************************************/
+void unpack_stream(stream<packet, TINF_WORD_DEPTH> &source, unsigned int sourceLen,
+                   stream<unsigned long long, TINF_WORD_DEPTH> &words);
+
+/***************************************************************//**
+* \brief Expand stage of the streaming kernel: writes literals and
+* matches to the AXI4-Stream port in segments of dLen bytes, see
+* fpga_uncompress_stream. Matches are copied from the window only,
+* which holds the current output as well. Updates the CRC32 and the
+* length of the output in history.
+*
+* @param tokens input stream of the decode stage
+* @param dest output port
+* @param dLen length of a segment (multiple of 8, at least 16)
+* @param *history window, CRC32 and length of the output, see tinf_history
+********************************************************************/
+void expand_stream(stream<struct tinf_token, TINF_TOKEN_DEPTH> &tokens,
+                   stream<packet, TINF_WORD_DEPTH> &dest, unsigned int dLen, struct tinf_history *history);
+
+/***************************************************************//**
+* \brief Expand stage of the verify kernel: inflates into the window
+* only and discards the output. Updates the CRC32 and the length of
+* the output in history.
+*
+* @param tokens input stream of the decode stage
+* @param *history window, CRC32 and length of the output, see tinf_history
+********************************************************************/
+void expand_verify(stream<struct tinf_token, TINF_TOKEN_DEPTH> &tokens,
+                   struct tinf_history *history);
+
 } //namepsace fpga
 
 /***************************************************************//**
-* \brief FPGA top-level function: Decompresses a block of a gzip
-* compressed file
+* \brief FPGA top-level function: Decompresses deflate blocks of a
+* gzip compressed file until the input window is exhausted, the
+* output buffer is full or the final block has been inflated
+*
+* Blocks may span any number of runs. The kernel stops at the last
+* whole symbol of the input window or when the output is full, and
+* keeps the block type, the code lengths of dynamic trees and a
+* pending match in the state record. The next run continues with a
+* new input window that starts at the returned position. Every run
+* writes from the begin of dest, matches that reach further back
+* are read from the last 32 KiB of output kept in history and
+* copied to on-chip memory for the run, so dest can be a small
+* buffer that is reused for every run.
+*
+* The CRC32 and the length of the output are computed while it is
+* written and kept in history as well, so the host only compares
+* them with the gzip footer after the final run.
 *
-* The function takes a buffer of 64kB, decompresses data and stores
-* it in a buffer of 100MB. Additionally, the parameters from the data
-* structure tinf_data have to be transported to the device. The
-* user has to copy tag, bitcount and overflow as one-component
-* arrays to global device memory in  order to ensure, that the data
-* is consistent throughout different kernel runs.
+* The kernel is a dataflow region of three stages connected by
+* FIFOs: unpack streams input words, decode turns them into literal
+* and match tokens and expand writes the output. In the CPU model
+* every stage runs in a thread of its own. The state
+* record has to stay in global device memory between runs in order
+* to ensure, that the data is consistent throughout different
+* kernel runs. The host has to zero it before the first run.
 *
 * @param *dest pointer to begin of output buffer
-* @param *dLen first component gets overridden with actual length of
-* output after successful run
-* @param *source pointer to begin of input buffer
-* @param *sourceLen first component gets overridden with actual
-* length of compressed block after successful run
-* @param *tag
-* @param *bitcount
-* @param *overflow
-* @param *bfinal after successful run the first component is 1 if
-* the block is the last one, 0 else
-* @param *err first element holds TINF_BUF_ERROR if there is not enough
-* room for output, TINF_DATA_ERROR if the data is corrupted or
-* TINF_OK else
+* @param dLen length of the output buffer
+* @param *source pointer to begin of input window
+* @param sourceLen length of the input window
+* @param *state resumable decoder state, see tinf_state
+* @param *history window, CRC32 and length of the output, stays in
+* global device memory, see tinf_history
+********************************************************************/
+extern "C" {
+void fpga_uncompress(unsigned char *dest,   unsigned int dLen,
+                     unsigned char *source, unsigned int sourceLen,
+                     struct fpga::tinf_state *state,
+                     struct fpga::tinf_history *history);
+}
+
+/***************************************************************//**
+* \brief Streaming variant of fpga_uncompress: reads the compressed
+* data from an AXI4-Stream port and writes the output to another
+* one, so the host pushes and pulls data without buffer migrations.
+*
+* A run reads exactly sourceLen bytes and inflates until the final
+* block, usually the whole deflate stream of a file in one run. The
+* output is split into segments of at most dLen bytes that end with
+* TLAST, such that every host read of dLen bytes completes with one
+* segment. A segment holds up to dLen - 8 bytes of output, zero
+* padded to whole words, and ends with a trailer word: the low 32
+* bits give the number of output bytes, the high 32 bits are 1 on
+* the final segment of the run. The output of a run is limited to
+* 4 GiB - 1 bytes, the state record tells if the run stopped early.
+*
+* @param dest output port
+* @param dLen length of a segment (multiple of 8, at least 16)
+* @param source input port
+* @param sourceLen number of bytes pushed to source
+* @param *state resumable decoder state, see tinf_state
+* @param *history window, CRC32 and length of the output, see tinf_history
+********************************************************************/
+extern "C" {
+void fpga_uncompress_stream(fpga::stream<fpga::packet, fpga::TINF_WORD_DEPTH> &dest, unsigned int dLen,
+                            fpga::stream<fpga::packet, fpga::TINF_WORD_DEPTH> &source, unsigned int sourceLen,
+                            struct fpga::tinf_state *state,
+                            struct fpga::tinf_history *history);
+}
+
+/***************************************************************//**
+* \brief Verify variant of fpga_uncompress for integrity tests: the
+* output goes to a discard sink, so no output buffer is written and
+* nothing but the state and history records is read back.
+*
+* A run inflates until the input window is exhausted or the final
+* block has been inflated, the output of a run is not limited. After
+* the final run, history holds the CRC32 and the length of the whole
+* output, which the host compares with the gzip footer.
+*
+* @param *source pointer to begin of input window
+* @param sourceLen length of the input window
+* @param *state resumable decoder state, see tinf_state
+* @param *history window, CRC32 and length of the output, see tinf_history
 ********************************************************************/
 extern "C" {
-void fpga_uncompress(unsigned char *dest,   unsigned int *dLen,
-                     unsigned char *source, unsigned int *sourceLen,
-			         unsigned int *tag, unsigned int *bitcount, unsigned int *overflow,
-			         int *bfinal, int *err);
+void fpga_verify(unsigned char *source, unsigned int sourceLen,
+                 struct fpga::tinf_state *state,
+                 struct fpga::tinf_history *history);
 }
 
 #endif /* FPGA_H_INCLUDED */
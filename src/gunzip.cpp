@@ -3,7 +3,8 @@
 #include <stdio.h>
 
 #include "argparse.h"
-#include "tinf_data.h"
+#include "decompressor.h"
+#include "daemon.h"
 
 using namespace argparse;
 
@@ -46,6 +47,7 @@ int main(int argc, const char *argv[])
 	parser.add_argument()
       .names({"-S", "--suffix"})
 	  .description("use suffix SUF on compressed files")
+	  .count(1)
 	  .required(false);
 	parser.add_argument()
       .names({"-t", "--test"})
@@ -54,6 +56,27 @@ int main(int argc, const char *argv[])
 	parser.add_argument()
       .names({"-b", "--binary"})
 	  .description("path to the device binary (default: ../binary_container_1.xclbin)")
+	  .count(1)
+	  .required(false);
+	parser.add_argument()
+      .names({"-m", "--memory"})
+	  .description("memory budget of the kernel buffers in MiB (default: no limit)")
+	  .count(1)
+	  .required(false);
+	parser.add_argument()
+      .names({"-B", "--backend"})
+	  .description("run the kernel on fpga (the cards), cpu (the host), hybrid (both) or auto (default: auto)")
+	  .count(1)
+	  .required(false);
+	parser.add_argument()
+      .names({"-D", "--daemon"})
+	  .description("run as daemon, take jobs on the Unix domain socket SOCK")
+	  .count(1)
+	  .required(false);
+	parser.add_argument()
+      .names({"-C", "--connect"})
+	  .description("forward the files to the daemon on the Unix domain socket SOCK")
+	  .count(1)
 	  .required(false);
 	parser.add_argument()
       .names({"-v", "--verbose"})
@@ -83,7 +106,7 @@ int main(int argc, const char *argv[])
 
 	if(parser.exists("help"))
     {
-	  std::cout << "Usage: " << argv[0] << " [OPTION]... [FILE(s)]... [-S ... -b ...]\n Uncompress FILEs (by default, in-place).\n\n Mandatory arguments to long options are mandatory for short options too.\n\n";
+	  std::cout << "Usage: " << argv[0] << " [OPTION]... [FILE(s)]...\n Uncompress FILEs (by default, in-place).\n\n Mandatory arguments to long options are mandatory for short options too.\n\n";
       parser.print_help();
       std::cout << "\nWith no FILE, or when FILE is -, read standard input.\n\n Report bugs to <Thomas.Karl@physik.uni-regensburg.de>.";
       return EXIT_SUCCESS;
@@ -93,30 +116,53 @@ int main(int argc, const char *argv[])
 
 	std::vector<std::string> input_list;
 	std::string file;
-	for(int i = 1; i < argc - 1; ++i)
+	for(int i = 1; i < argc; ++i)
 	{
 		file = argv[i];
 
-		if( file.compare("-S") == 0 ||
-			file.compare("-b") == 0) break;
-
-		if( file.compare("-c") != 0 &&
-			file.compare("-f") != 0 &&
-			file.compare("-k") != 0 &&
-			file.compare("-l") != 0 &&
-			file.compare("-n") != 0 &&
-			file.compare("-N") != 0 &&
-			file.compare("-q") != 0 &&
-			file.compare("-r") != 0 &&
-			file.compare("-t") != 0 &&
-			file.compare("-V") != 0 &&
-			file.compare("-v") != 0) input_list.push_back(file);
+		//Options with a value, the value is no file
+		if( file.compare("-S") == 0 || file.compare("--suffix")  == 0 ||
+			file.compare("-b") == 0 || file.compare("--binary")  == 0 ||
+			file.compare("-m") == 0 || file.compare("--memory")  == 0 ||
+			file.compare("-B") == 0 || file.compare("--backend") == 0 ||
+			file.compare("-D") == 0 || file.compare("--daemon")  == 0 ||
+			file.compare("-C") == 0 || file.compare("--connect") == 0)
+		{
+			++i;
+			continue;
+		}
+
+		//Any other option, "-" alone is standard input
+		if(file.size() < 2 || file[0] != '-') input_list.push_back(file);
 	}
-	if(input_list.size() == 0 && !parser.exists("q")) std::cerr << "You did not specify any files!\n";
-	std::reverse(std::begin(input_list), std::end(input_list));
+	//Options of the library
+	inf::options opt;
+	if(parser.exists("b")) opt.binary = parser.get<std::string>("b");
+	if(parser.exists("m")) opt.memory = parser.get<size_t>("m") << 20;
+	if(parser.exists("B")) opt.backend = parser.get<std::string>("B");
+	if(parser.exists("S")) opt.suffix = parser.get<std::string>("S");
+	if(parser.exists("D")) opt.socket = parser.get<std::string>("D");
+	if(parser.exists("C")) opt.socket = parser.get<std::string>("C");
+	opt.to_stdout = parser.exists("c");
+	opt.force     = parser.exists("f");
+	opt.keep      = parser.exists("k");
+	opt.list      = parser.exists("l");
+	opt.listing   = &std::cout;
+	opt.no_name   = parser.exists("n");
+	opt.name      = parser.exists("N");
+	opt.quiet     = parser.exists("q");
+	opt.test      = parser.exists("t");
+	opt.verbose   = parser.exists("v");
+
+	if(parser.exists("D")) return inf::run_daemon(opt);
+
+	//Without files the decompression reads standard input
+	bool piped = input_list.size() == 0 && !parser.exists("t") && !parser.exists("l") && !parser.exists("C");
+	if(input_list.size() == 0 && !piped && !parser.exists("q")) std::cerr << "You did not specify any files!\n";
 
-	if(parser.exists("-t") || parser.exists("-l")) err = inf::check_integrity(input_list, parser);
-	else                                           err = inf::gzip_uncompress(input_list, parser);
+	if(parser.exists("-t") || parser.exists("-l")) err = inf::check_integrity(input_list, opt);
+	else if(parser.exists("C"))                    err = inf::run_client(input_list, opt);
+	else                                           err = inf::gzip_uncompress(input_list, opt);
 
 	return err;
 }
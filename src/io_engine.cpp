@@ -0,0 +1,326 @@
+#include "io_engine.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define INF_IO_URING
+#endif
+#endif
+
+#if defined(INF_IO_URING) && !(defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS))
+#undef INF_IO_URING //Headers older than the read and write opcodes
+#endif
+
+inf::io_request inf::io_request::read(int fd, void *data, size_t length, off_t offset)
+{
+	inf::io_request r;
+	r.fd     = fd;
+	r.data   = (unsigned char *) data;
+	r.length = length;
+	r.offset = offset;
+
+	return r;
+}
+
+inf::io_request inf::io_request::write(int fd, const void *data, size_t length, off_t offset)
+{
+	inf::io_request r = read(fd, const_cast<void *>(data), length, offset);
+	r.output = true;
+
+	return r;
+}
+
+inf::io_engine &inf::io_engine::shared()
+{
+	static inf::io_engine engine(getenv("INF_IO") == NULL || std::string(getenv("INF_IO")) != "threads");
+
+	return engine;
+}
+
+inf::io_engine::io_engine(bool uring)
+  : stop(false), ring_fd(-1), sq_ring(MAP_FAILED), cq_ring(MAP_FAILED), sqes(MAP_FAILED),
+    sq_ring_size(0), cq_ring_size(0), sqes_size(0), entries(0), pending(0), inflight(0)
+{
+#ifdef INF_IO_URING
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+
+	if(uring) ring_fd = syscall(__NR_io_uring_setup, QUEUE_DEPTH, &p);
+
+	//Kernels before 5.6 have no plain read and write, they get the thread pool
+	if(ring_fd >= 0 && !(p.features & IORING_FEAT_RW_CUR_POS))
+	{
+		close(ring_fd);
+		ring_fd = -1;
+	}
+
+	if(ring_fd >= 0)
+	{
+		//Submission and completion rings, shared with the kernel
+		sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+		cq_ring_size = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+		sqes_size    = p.sq_entries * sizeof(struct io_uring_sqe);
+
+		bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+		if(single) sq_ring_size = cq_ring_size = sq_ring_size > cq_ring_size ? sq_ring_size : cq_ring_size;
+
+		sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+		cq_ring = single ? sq_ring : mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+		sqes    = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+
+		if(sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED)
+		{
+			if(sqes    != MAP_FAILED) munmap(sqes, sqes_size);
+			if(cq_ring != MAP_FAILED && !single) munmap(cq_ring, cq_ring_size);
+			if(sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_size);
+			close(ring_fd);
+			ring_fd = -1;
+		}
+	}
+
+	if(ring_fd >= 0)
+	{
+		unsigned char *sq = (unsigned char *) sq_ring;
+		unsigned char *cq = (unsigned char *) cq_ring;
+
+		sq_tail  = (unsigned int *) (sq + p.sq_off.tail);
+		sq_mask  = (unsigned int *) (sq + p.sq_off.ring_mask);
+		sq_array = (unsigned int *) (sq + p.sq_off.array);
+		cq_head  = (unsigned int *) (cq + p.cq_off.head);
+		cq_tail  = (unsigned int *) (cq + p.cq_off.tail);
+		cq_mask  = (unsigned int *) (cq + p.cq_off.ring_mask);
+		cqes     = cq + p.cq_off.cqes;
+
+		//The completion ring holds twice the requests in flight, it never overflows
+		entries = p.sq_entries;
+		threads.emplace_back(&inf::io_engine::reap, this);
+		return;
+	}
+#else
+	(void) uring;
+#endif
+
+	for(unsigned int t = 0; t < POOL_THREADS; ++t) threads.emplace_back(&inf::io_engine::serve, this);
+}
+
+inf::io_engine::~io_engine()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stop = true;
+
+		//A no-op request wakes the completion thread up
+		if(ring_fd >= 0 && queue(NULL)) enter();
+		changed.notify_all();
+	}
+
+	for(size_t t = 0; t < threads.size(); ++t) threads[t].join();
+
+	if(ring_fd >= 0)
+	{
+		munmap(sqes, sqes_size);
+		if(cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+		munmap(sq_ring, sq_ring_size);
+		close(ring_fd);
+	}
+}
+
+void inf::io_engine::submit(inf::io_request *requests, size_t count)
+{
+	std::lock_guard<std::mutex> guard(lock);
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		requests[i].result = 0;
+		requests[i].done   = false;
+
+		//Requests beyond the depth of the ring wait for free entries
+		if(ring_fd < 0 || !waiting.empty() || !queue(&requests[i])) waiting.push_back(&requests[i]);
+	}
+
+	if(ring_fd >= 0) enter(); //All requests of the batch with one system call
+	else             changed.notify_all();
+}
+
+void inf::io_engine::wait(inf::io_request *requests, size_t count)
+{
+	std::unique_lock<std::mutex> guard(lock);
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		changed.wait(guard, [&]() { return requests[i].done; });
+	}
+}
+
+bool inf::io_engine::run(inf::io_request *requests, size_t count)
+{
+	submit(requests, count);
+	wait(requests, count);
+
+	bool ok = true;
+	for(size_t i = 0; i < count; ++i) ok = ok && requests[i].result == (ssize_t) requests[i].length;
+
+	return ok;
+}
+
+int inf::io_engine::regular_fd(FILE *fin)
+{
+	int fd = fin != NULL ? fileno(fin) : -1;
+
+	struct stat st;
+	if(fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return -1;
+
+	return fd;
+}
+
+bool inf::io_engine::queue(inf::io_request *request)
+{
+#ifdef INF_IO_URING
+	if(pending + inflight >= entries) return false;
+
+	unsigned int tail  = *sq_tail;
+	unsigned int index = tail & *sq_mask;
+
+	struct io_uring_sqe *sqe = (struct io_uring_sqe *) sqes + index;
+	memset(sqe, 0, sizeof(*sqe));
+
+	if(request == NULL) sqe->opcode = IORING_OP_NOP;
+	else
+	{
+		//The rest of the range after the bytes already transferred
+		sqe->opcode = request->output ? IORING_OP_WRITE : IORING_OP_READ;
+		sqe->fd     = request->fd;
+		sqe->addr   = (unsigned long long) (request->data + request->result);
+		sqe->len    = request->length - request->result < (1U << 30) ? request->length - request->result : (1U << 30);
+		sqe->off    = request->offset + request->result;
+	}
+	sqe->user_data = (unsigned long long) request;
+
+	sq_array[index] = index;
+	__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+	++pending;
+
+	return true;
+#else
+	(void) request;
+	return false;
+#endif
+}
+
+void inf::io_engine::enter()
+{
+#ifdef INF_IO_URING
+	while(pending > 0)
+	{
+		int n = syscall(__NR_io_uring_enter, ring_fd, pending, 0, 0, NULL, 0);
+		if(n < 0)
+		{
+			if(errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+			break; //The entries stay on the ring, the next enter submits them
+		}
+
+		pending  -= n;
+		inflight += n;
+	}
+#endif
+}
+
+void inf::io_engine::transferred(inf::io_request *request, ssize_t res)
+{
+	if(res == -EINTR || res == -EAGAIN)
+	{
+		//Interrupted, the same range again
+	}
+	else if(res < 0)
+	{
+		request->result = res;
+		request->done   = true;
+		return;
+	}
+	else
+	{
+		request->result += res;
+		if(res == 0 || (size_t) request->result == request->length)
+		{
+			request->done = true;
+			return;
+		}
+	}
+
+	if(!queue(request)) waiting.push_front(request);
+}
+
+void inf::io_engine::reap()
+{
+#ifdef INF_IO_URING
+	struct io_uring_cqe *ring = (struct io_uring_cqe *) cqes;
+
+	for(;;)
+	{
+		unsigned int head = *cq_head;
+		if(head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+		{
+			//Sleep until a request completes
+			syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+			continue;
+		}
+
+		struct io_uring_cqe cqe = ring[head & *cq_mask];
+		__atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+
+		std::lock_guard<std::mutex> guard(lock);
+		--inflight;
+		if(cqe.user_data != 0) transferred((inf::io_request *) cqe.user_data, cqe.res);
+
+		//Waiting requests into the entries that became free
+		while(!waiting.empty() && queue(waiting.front())) waiting.pop_front();
+		enter();
+		changed.notify_all();
+
+		if(stop && inflight == 0 && pending == 0 && waiting.empty()) break;
+	}
+#endif
+}
+
+void inf::io_engine::serve()
+{
+	for(;;)
+	{
+		inf::io_request *request;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			changed.wait(guard, [&]() { return stop || !waiting.empty(); });
+			if(waiting.empty()) return;
+
+			request = waiting.front();
+			waiting.pop_front();
+		}
+
+		size_t total = 0;
+		ssize_t res  = 0;
+		while(total < request->length)
+		{
+			if(request->output) res = pwrite(request->fd, request->data + total, request->length - total, request->offset + total);
+			else                res = pread (request->fd, request->data + total, request->length - total, request->offset + total);
+
+			if(res < 0 && errno == EINTR) continue;
+			if(res < 0) res = -errno;
+			if(res <= 0) break;
+			total += res;
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+		request->result = res < 0 ? res : (ssize_t) total;
+		request->done   = true;
+		changed.notify_all();
+	}
+}
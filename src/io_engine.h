@@ -0,0 +1,155 @@
+#ifndef IO_ENGINE_H_INCLUDED
+#define IO_ENGINE_H_INCLUDED
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace inf {
+
+/***************************************************************//**
+* \brief A read or write of a byte range of a file, see io_engine
+********************************************************************/
+struct io_request {
+    io_request() : fd(-1), data(NULL), length(0), offset(0), output(false), result(0), done(false) {}
+
+    /***************************************************************//**
+    * \brief Returns a request that reads length bytes from offset of fd
+    ********************************************************************/
+    static io_request read(int fd, void *data, size_t length, off_t offset);
+
+    /***************************************************************//**
+    * \brief Returns a request that writes length bytes to offset of fd
+    ********************************************************************/
+    static io_request write(int fd, const void *data, size_t length, off_t offset);
+
+    int fd;              /**< file descriptor */
+    unsigned char *data; /**< bytes to write, or room for the bytes read */
+    size_t length;       /**< length of the range in bytes */
+    off_t offset;        /**< begin of the range in the file */
+    bool output;         /**< true for a write */
+
+    ssize_t result;      /**< bytes transferred, less on end of file, or -errno */
+    bool done;           /**< set when result is final */
+};
+
+/***************************************************************//**
+* \brief Asynchronous reads and writes of files, shared by all threads.
+*
+* Requests are submitted in batches and complete in any order, so the
+* footer probes of thousands of files or the outputs of several kernel
+* runs cost one system call instead of one per request. Requests are
+* run by io_uring, or by a pool of threads if the kernel has no
+* io_uring or the environment variable INF_IO is set to "threads".
+* Short transfers are continued until the whole range is done, the
+* end of a file is reached or an error occurs.
+*
+* All functions may be called from any thread. A request must stay in
+* place until it is done.
+********************************************************************/
+class io_engine
+{
+  public:
+    /***************************************************************//**
+    * Number of requests in flight at most, more are queued
+    ********************************************************************/
+    static const unsigned int QUEUE_DEPTH = 256;
+
+    /***************************************************************//**
+    * Number of threads of the fallback without io_uring
+    ********************************************************************/
+    static const unsigned int POOL_THREADS = 8;
+
+    /***************************************************************//**
+    * \brief Returns the engine of the process, started on first use
+    ********************************************************************/
+    static io_engine &shared();
+
+    /***************************************************************//**
+    * @param uring use io_uring if the kernel supports it, the thread
+    * pool otherwise
+    ********************************************************************/
+    explicit io_engine(bool uring);
+    ~io_engine();
+
+    io_engine(const io_engine &) = delete;
+    io_engine &operator=(const io_engine &) = delete;
+
+    /***************************************************************//**
+    * \brief Returns "io_uring" or "threads"
+    ********************************************************************/
+    const char *name() const { return ring_fd >= 0 ? "io_uring" : "threads"; }
+
+    /***************************************************************//**
+    * \brief Starts count requests, without waiting for them
+    ********************************************************************/
+    void submit(io_request *requests, size_t count);
+
+    /***************************************************************//**
+    * \brief Waits until count requests are done
+    ********************************************************************/
+    void wait(io_request *requests, size_t count);
+
+    /***************************************************************//**
+    * \brief Runs count requests and waits for all of them. Returns
+    * true if every request transferred its whole range.
+    ********************************************************************/
+    bool run(io_request *requests, size_t count);
+
+    /***************************************************************//**
+    * \brief Returns the descriptor of a regular file opened as fin,
+    * -1 for pipes, terminals and files in memory
+    ********************************************************************/
+    static int regular_fd(FILE *fin);
+
+  private:
+    /***************************************************************//**
+    * \brief Queues the remaining range of a request on the ring,
+    * entered with lock held. Returns false if the ring is full.
+    ********************************************************************/
+    bool queue(io_request *request);
+
+    /***************************************************************//**
+    * \brief Hands all queued requests to the kernel, with lock held
+    ********************************************************************/
+    void enter();
+
+    /***************************************************************//**
+    * \brief Adds a transfer of res bytes to a request, and continues it
+    * or marks it done
+    ********************************************************************/
+    void transferred(io_request *request, ssize_t res);
+
+    void reap();   /**< completion thread of io_uring */
+    void serve();  /**< worker thread of the pool */
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<io_request *> waiting; /**< not yet in flight */
+    bool stop;
+
+    //io_uring
+    int ring_fd;
+    void *sq_ring;
+    void *cq_ring;
+    void *sqes;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned int *sq_tail, *sq_mask, *sq_array;
+    unsigned int *cq_head, *cq_tail, *cq_mask;
+    void *cqes;
+    unsigned int entries;
+    unsigned int pending;  /**< queued on the ring, not yet entered */
+    unsigned int inflight; /**< entered, not yet completed */
+
+    std::vector<std::thread> threads;
+};
+
+} //namespace inf
+
+#endif /* IO_ENGINE_H_INCLUDED */
@@ -0,0 +1,159 @@
+#include "job_scheduler.h"
+#include "io_engine.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+/* Files probed at once, their descriptors stay open until the footers are read */
+const size_t PROBE_GROUP = 256;
+
+} //namespace
+
+inf::job_scheduler::job_scheduler(const std::vector<std::string> &files, unsigned int units,
+                                  const cost_function &cost)
+  : cost(cost)
+{
+	std::vector<job> jobs;
+
+	for(size_t i = 0; i < files.size(); ++i)
+	{
+		job j = {files[i], 0, 0, 0};
+		jobs.push_back(j);
+	}
+	probe(jobs);
+
+	//Largest first, files of equal size in the given order
+	std::stable_sort(jobs.begin(), jobs.end(), [](const job &a, const job &b) { return a.size > b.size; });
+
+	if(units == 0) units = 1;
+	for(unsigned int u = 0; u < units; ++u) queues.emplace_back(new job_queue());
+
+	//Each file to the queue that finishes it first, the one with the fewest pending bytes if all units are alike
+	for(size_t i = 0; i < jobs.size(); ++i)
+	{
+		unsigned int best = 0;
+		double finish = queues[0]->pending + cost_of(0, jobs[i]);
+		for(unsigned int u = 1; u < units; ++u)
+		{
+			double f = queues[u]->pending + cost_of(u, jobs[i]);
+			if(f < finish)
+			{
+				best   = u;
+				finish = f;
+			}
+		}
+
+		jobs[i].cost = cost_of(best, jobs[i]);
+		queues[best]->jobs.push_back(jobs[i]);
+		queues[best]->pending += jobs[i].cost;
+	}
+}
+
+bool inf::job_scheduler::next(unsigned int unit, std::string &file)
+{
+	//Own queue first
+	if(pop(*queues[unit % queues.size()], file)) return true;
+
+	//Steal from the queue with the most pending work until none is left that this unit finishes sooner
+	for(;;)
+	{
+		job_queue *victim = NULL;
+		bool back = false;
+		double most = -1;
+
+		for(size_t u = 0; u < queues.size(); ++u)
+		{
+			std::lock_guard<std::mutex> guard(queues[u]->lock);
+			job_queue &q = *queues[u];
+			if(q.jobs.empty() || q.pending <= most) continue;
+
+			//The largest file if this unit is done with it before the queue would be, else the smallest
+			if(cost_of(unit, q.jobs.front()) <= q.pending)
+			{
+				victim = &q;
+				back   = false;
+				most   = q.pending;
+			}
+			else if(cost_of(unit, q.jobs.back()) <= q.pending)
+			{
+				victim = &q;
+				back   = true;
+				most   = q.pending;
+			}
+		}
+
+		if(victim == NULL) return false;
+		if(pop(*victim, file, back)) return true;
+	}
+}
+
+void inf::job_scheduler::probe(std::vector<job> &jobs)
+{
+	inf::io_engine &io = inf::io_engine::shared();
+
+	for(size_t first = 0; first < jobs.size(); first += PROBE_GROUP)
+	{
+		size_t last = std::min(jobs.size(), first + PROBE_GROUP);
+
+		std::vector<int> fds;
+		std::vector<unsigned char> footers(4 * (last - first));
+		std::vector<inf::io_request> requests;
+		std::vector<size_t> probed;
+
+		//Sizes of the group, then ISIZE, little endian, in the last four bytes of every footer
+		for(size_t i = first; i < last; ++i)
+		{
+			int fd = open(jobs[i].file.c_str(), O_RDONLY);
+			if(fd < 0) continue;
+			fds.push_back(fd);
+
+			struct stat st;
+			if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+			jobs[i].size = st.st_size;
+
+			if(st.st_size < 18) continue;
+			requests.push_back(inf::io_request::read(fd, &footers[4 * (i - first)], 4, st.st_size - 4));
+			probed.push_back(i);
+		}
+
+		io.submit(requests.data(), requests.size());
+		io.wait(requests.data(), requests.size());
+
+		for(size_t r = 0; r < requests.size(); ++r)
+		{
+			if(requests[r].result != 4) continue;
+
+			const unsigned char *footer = requests[r].data;
+			jobs[probed[r]].isize = footer[0] | (footer[1] << 8) | (footer[2] << 16) | ((unsigned int) footer[3] << 24);
+		}
+
+		for(size_t f = 0; f < fds.size(); ++f) close(fds[f]);
+	}
+}
+
+double inf::job_scheduler::cost_of(unsigned int unit, const job &j) const
+{
+	if(!cost) return j.size;
+
+	return cost(unit, j.size, j.isize);
+}
+
+bool inf::job_scheduler::pop(job_queue &queue, std::string &file, bool back)
+{
+	std::lock_guard<std::mutex> guard(queue.lock);
+
+	if(queue.jobs.empty()) return false;
+
+	job &j = back ? queue.jobs.back() : queue.jobs.front();
+	file = j.file;
+	queue.pending -= j.cost;
+
+	if(back) queue.jobs.pop_back();
+	else     queue.jobs.pop_front();
+
+	return true;
+}
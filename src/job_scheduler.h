@@ -0,0 +1,98 @@
+#ifndef JOB_SCHEDULER_H_INCLUDED
+#define JOB_SCHEDULER_H_INCLUDED
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace inf {
+
+/***************************************************************//**
+* \brief Distributes files onto compute units, largest first.
+*
+* Every compute unit has a queue of its own. The files are sorted by
+* their compressed size and each one is put into the queue with the
+* minimum estimated finish time, its pending cost plus the cost of
+* the file on its unit, so the queues are balanced and ordered from
+* the largest to the smallest file. A compute unit whose queue has
+* run dry steals from the queue with the most pending cost: its
+* largest file if the unit finishes it before the queue would, else
+* its smallest, so all compute units stay busy until every file is
+* done. All functions may be called from any thread.
+*
+* If the compute units differ, e.g. cards and host threads, a cost
+* function estimates the run time of a file on every unit. Without
+* a cost function the cost of a file is its size, and the estimated
+* finish time of a queue its pending bytes.
+********************************************************************/
+class job_scheduler
+{
+  public:
+    /***************************************************************//**
+    * \brief Estimated cost of a file on a compute unit, from its
+    * compressed size and the ISIZE of its footer
+    ********************************************************************/
+    typedef std::function<double(unsigned int unit, long size, unsigned int isize)> cost_function;
+
+    /***************************************************************//**
+    * @param files paths to the input files
+    * @param units number of compute units
+    * @param cost cost of a file on a unit, the size if empty
+    ********************************************************************/
+    job_scheduler(const std::vector<std::string> &files, unsigned int units,
+                  const cost_function &cost = cost_function());
+
+    /***************************************************************//**
+    * \brief Takes the next file for compute unit unit (counted from 0).
+    * Returns false when no file is left.
+    *
+    * @param unit compute unit asking for work
+    * @param file gets overridden with the path of the file
+    ********************************************************************/
+    bool next(unsigned int unit, std::string &file);
+
+  private:
+    /* A file, its compressed size and uncompressed size mod 2^32 */
+    struct job {
+      std::string file;
+      long size;
+      unsigned int isize;
+      double cost;        /**< cost on the unit of its queue */
+    };
+
+    /* Pending jobs of a compute unit, largest first */
+    struct job_queue {
+      job_queue() : pending(0) {}
+
+      std::mutex lock;
+      std::deque<job> jobs;
+      double pending; /**< sum of the costs of jobs */
+    };
+
+    /***************************************************************//**
+    * \brief Reads size and ISIZE of every job, the footers of many
+    * files in one batch of the shared io_engine
+    ********************************************************************/
+    static void probe(std::vector<job> &jobs);
+
+    /***************************************************************//**
+    * \brief Returns the cost of a job on a unit
+    ********************************************************************/
+    double cost_of(unsigned int unit, const job &j) const;
+
+    /***************************************************************//**
+    * \brief Pops the front or back job of queue, returns false if it
+    * is empty
+    ********************************************************************/
+    static bool pop(job_queue &queue, std::string &file, bool back = false);
+
+    cost_function cost;
+    std::vector<std::unique_ptr<job_queue>> queues; /**< by compute unit */
+};
+
+} //namespace inf
+
+#endif /* JOB_SCHEDULER_H_INCLUDED */
@@ -0,0 +1,71 @@
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//Definition of the constant, std::min takes it by reference
+const size_t inf::mapped_file::MAP_WINDOW;
+
+inf::mapped_file::mapped_file(FILE *fin, long offset, size_t length)
+  : fd(fin != NULL ? fileno(fin) : -1), offset(offset), length(length), base(NULL), base_offset(0), base_length(0)
+{
+	struct stat st;
+	if(fd < 0 || length == 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return;
+
+	//Pages beyond the end of the file would fault on access
+	if(offset < 0 || offset + (long long) length > (long long) st.st_size) return;
+
+	//The whole range, or its first window if the address space is too small
+	if(!map(offset, length)) map(offset, std::min(length, MAP_WINDOW));
+}
+
+inf::mapped_file::~mapped_file()
+{
+	unmap();
+}
+
+const unsigned char *inf::mapped_file::window(size_t position, size_t size)
+{
+	if(base == NULL || position > length || size > length - position) return NULL;
+
+	//Map the next window if the bytes are not mapped yet
+	long begin = offset + position;
+	if(begin < base_offset || begin + (long) size > base_offset + (long) base_length)
+	{
+		if(!map(begin, std::max(size, std::min(length - position, MAP_WINDOW)))) return NULL;
+	}
+
+	return base + (begin - base_offset);
+}
+
+bool inf::mapped_file::map(long begin, size_t size)
+{
+	unmap();
+
+	//Mappings start at a page boundary
+	long page    = sysconf(_SC_PAGESIZE);
+	long aligned = begin - begin % page;
+	size_t total = size + (begin - aligned);
+
+	void *pages = mmap(NULL, total, PROT_READ, MAP_PRIVATE, fd, aligned);
+	if(pages == MAP_FAILED) return false;
+
+	madvise(pages, total, MADV_SEQUENTIAL);
+
+	base        = (unsigned char *) pages;
+	base_offset = aligned;
+	base_length = total;
+
+	return true;
+}
+
+void inf::mapped_file::unmap()
+{
+	if(base != NULL) munmap(base, base_length);
+
+	base        = NULL;
+	base_offset = 0;
+	base_length = 0;
+}
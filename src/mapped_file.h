@@ -0,0 +1,78 @@
+#ifndef MAPPED_FILE_H_INCLUDED
+#define MAPPED_FILE_H_INCLUDED
+
+#include <stdio.h>
+#include <stddef.h>
+
+namespace inf {
+
+/***************************************************************//**
+* \brief Read-only memory mapping of a byte range of a file, e.g. the
+* deflate stream of a gzip file.
+*
+* The whole range is mapped at once if the address space allows it,
+* otherwise it is mapped in windows of MAP_WINDOW bytes that follow
+* the reads. The kernel reads its input windows straight from the
+* mapping, so no byte is read twice from the file and the unused
+* rest of a window needs no copy. The pages are advised for
+* sequential reading, so the kernel prefetches ahead and drops them
+* behind the reads.
+*
+* Files that cannot be mapped, e.g. pipes or files in memory, are not
+* mapped at all, see mapped(); the caller reads them instead.
+********************************************************************/
+class mapped_file
+{
+  public:
+    /***************************************************************//**
+    * Size of a window of the mapping in bytes, if the whole range does
+    * not fit into the address space
+    ********************************************************************/
+    static const size_t MAP_WINDOW = 64 << 20;
+
+    /***************************************************************//**
+    * @param fin file to map, it is not read and stays open
+    * @param offset begin of the range in the file in bytes
+    * @param length length of the range in bytes
+    ********************************************************************/
+    mapped_file(FILE *fin, long offset, size_t length);
+    ~mapped_file();
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    /***************************************************************//**
+    * \brief Returns true if the range is mapped
+    ********************************************************************/
+    bool mapped() const { return base != NULL; }
+
+    /***************************************************************//**
+    * \brief Returns the bytes of the range from position on, NULL if
+    * they cannot be mapped. The pointer stays valid until the next call.
+    *
+    * @param position offset in the range in bytes
+    * @param size number of bytes needed, at most MAP_WINDOW
+    ********************************************************************/
+    const unsigned char *window(size_t position, size_t size);
+
+  private:
+    /***************************************************************//**
+    * \brief Maps size bytes of the file from the page that holds
+    * the file offset begin on. Returns false if it failed.
+    ********************************************************************/
+    bool map(long begin, size_t size);
+
+    void unmap();
+
+    int fd;
+    long offset;
+    size_t length;
+
+    unsigned char *base; /**< begin of the mapping, page aligned */
+    long base_offset;    /**< file offset of base */
+    size_t base_length;  /**< length of the mapping in bytes */
+};
+
+} //namespace inf
+
+#endif /* MAPPED_FILE_H_INCLUDED */
@@ -0,0 +1,110 @@
+#ifndef STATICTREE_H_INCLUDED
+#define STATICTREE_H_INCLUDED
+
+#include "fpga_data.h"
+
+namespace fpga {
+
+/***************************************************************//**
+* \brief Compile-time lookup tables of the fixed Huffman codes
+* (BTYPE=1) specified in rfc1951, section 3.2.6.
+*
+* Fixed blocks are decoded directly through these tables, no tree
+* has to be built at runtime. All codes fit into the primary table,
+* so there are no sub-tables.
+********************************************************************/
+namespace statictree {
+
+/***************************************************************//**
+* Index bits of the fixed literal/length and distance tables
+********************************************************************/
+static const int LITERAL_BITS  = 9;
+static const int DISTANCE_BITS = 5;
+
+/***************************************************************//**
+* \brief Reverses the len lowest bits of code
+********************************************************************/
+constexpr unsigned int reverse(unsigned int code, int len)
+{
+	return len == 0 ? 0 : ((code & 1) << (len - 1)) | reverse(code >> 1, len - 1);
+}
+
+/***************************************************************//**
+* \brief Returns the table entry of a 9 bit literal/length code
+* (MSB first). Shorter codes occupy all entries sharing their
+* leading bits.
+*
+* Lit Value    Bits        Codes
+* ---------    ----        -----
+*   0 - 143     8          00110000 through 10111111
+* 144 - 255     9          110010000 through 111111111
+* 256 - 279     7          0000000 through 0010111
+* 280 - 287     8          11000000 through 11000111
+********************************************************************/
+constexpr struct tinf_entry literal_entry(unsigned int code)
+{
+	return (code >> 2) <  24 ? tinf_entry{(unsigned short)(256 + (code >> 2)),       7, 0}
+	     : (code >> 1) < 192 ? tinf_entry{(unsigned short)((code >> 1) - 48),        8, 0}
+	     : (code >> 1) < 200 ? tinf_entry{(unsigned short)((code >> 1) - 192 + 280), 8, 0}
+	     :                     tinf_entry{(unsigned short)(code - 400 + 144),        9, 0};
+}
+
+/***************************************************************//**
+* \brief Returns the table entry of a 5 bit distance code
+* (MSB first)
+********************************************************************/
+constexpr struct tinf_entry distance_entry(unsigned int code)
+{
+	return tinf_entry{(unsigned short) code, 5, 0};
+}
+
+/***************************************************************//**
+* Compile-time list of table indices 0, 1, ..., N-1
+********************************************************************/
+template <unsigned int... I> struct index_list {};
+
+template <unsigned int N, unsigned int... I>
+struct make_index_list : make_index_list<N - 1, N - 1, I...> {};
+
+template <unsigned int... I>
+struct make_index_list<0, I...> { typedef index_list<I...> type; };
+
+/***************************************************************//**
+* Tables indexed by the next bits of the stream (LSB first)
+********************************************************************/
+template <typename L> struct literal_table;
+template <typename L> struct distance_table;
+
+template <unsigned int... I>
+struct literal_table<index_list<I...> >
+{
+	static constexpr struct tinf_entry entry[sizeof...(I)] = { literal_entry(reverse(I, LITERAL_BITS))... };
+};
+
+template <unsigned int... I>
+struct distance_table<index_list<I...> >
+{
+	static constexpr struct tinf_entry entry[sizeof...(I)] = { distance_entry(reverse(I, DISTANCE_BITS))... };
+};
+
+template <unsigned int... I>
+constexpr struct tinf_entry literal_table<index_list<I...> >::entry[sizeof...(I)];
+
+template <unsigned int... I>
+constexpr struct tinf_entry distance_table<index_list<I...> >::entry[sizeof...(I)];
+
+typedef  literal_table<make_index_list<1U << LITERAL_BITS >::type> fixed_literal;
+typedef distance_table<make_index_list<1U << DISTANCE_BITS>::type> fixed_distance;
+
+static_assert(fixed_literal::entry[0x000].sym == 256 && fixed_literal::entry[0x000].bits == 7, "fixed literal table");
+static_assert(fixed_literal::entry[0x00C].sym ==   0 && fixed_literal::entry[0x00C].bits == 8, "fixed literal table");
+static_assert(fixed_literal::entry[0x003].sym == 280 && fixed_literal::entry[0x003].bits == 8, "fixed literal table");
+static_assert(fixed_literal::entry[0x013].sym == 144 && fixed_literal::entry[0x013].bits == 9, "fixed literal table");
+static_assert(fixed_literal::entry[0x1FF].sym == 255 && fixed_literal::entry[0x1FF].bits == 9, "fixed literal table");
+static_assert(fixed_distance::entry[0x01].sym == 16 && fixed_distance::entry[0x1F].sym == 31, "fixed distance table");
+
+} //namespace statictree
+
+} //namespace fpga
+
+#endif /* STATICTREE_H_INCLUDED */
@@ -0,0 +1,105 @@
+#ifndef STREAM_H_INCLUDED
+#define STREAM_H_INCLUDED
+
+#ifdef __SYNTHESIS__
+#include "ap_axi_sdata.h"
+#include "hls_stream.h"
+#else
+#include <atomic>
+#include <thread>
+#include <vector>
+#endif
+
+namespace fpga {
+
+#ifdef __SYNTHESIS__
+
+/***************************************************************//**
+* FIFO between two stages of the dataflow region, an hls::stream
+* in hardware
+********************************************************************/
+template <typename T, unsigned int DEPTH>
+using stream = hls::stream<T>;
+
+/***************************************************************//**
+* Beat of an AXI4-Stream port of a streaming kernel
+********************************************************************/
+typedef ap_axiu<64, 0, 0, 0> packet;
+
+#else
+
+/***************************************************************//**
+* \brief FIFO between two stages of the dataflow region for the CPU
+* model, where every stage runs in a thread of its own.
+*
+* Single producer and single consumer ring of DEPTH entries with the
+* read()/write() interface of hls::stream. Both calls block: a
+* writer waits while the ring is full, a reader while it is empty.
+*
+* @tparam T entry type
+* @tparam DEPTH number of entries (power of two)
+********************************************************************/
+template <typename T, unsigned int DEPTH>
+class stream
+{
+  static_assert((DEPTH & (DEPTH - 1)) == 0, "stream depth must be a power of two");
+
+  public:
+    stream() : ring(DEPTH), head(0), tail(0) {}
+
+    stream(const stream&) = delete;
+    stream& operator=(const stream&) = delete;
+
+    /***************************************************************//**
+    * \brief Appends an entry, waits while the ring is full
+    ********************************************************************/
+    void write(const T &value)
+    {
+      unsigned int t = tail.load(std::memory_order_relaxed);
+      while(t - head.load(std::memory_order_acquire) == DEPTH) std::this_thread::yield();
+      ring[t & (DEPTH - 1)] = value;
+      tail.store(t + 1, std::memory_order_release);
+    }
+
+    /***************************************************************//**
+    * \brief Removes and returns the oldest entry, waits while the
+    * ring is empty
+    ********************************************************************/
+    T read()
+    {
+      unsigned int h = head.load(std::memory_order_relaxed);
+      while(tail.load(std::memory_order_acquire) == h) std::this_thread::yield();
+      T value = ring[h & (DEPTH - 1)];
+      head.store(h + 1, std::memory_order_release);
+      return value;
+    }
+
+    /***************************************************************//**
+    * \brief Returns true if there is no entry to be read
+    ********************************************************************/
+    bool empty() const
+    {
+      return tail.load(std::memory_order_acquire) == head.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::vector<T> ring;
+    std::atomic<unsigned int> head; /**< number of entries read */
+    std::atomic<unsigned int> tail; /**< number of entries written */
+};
+
+/***************************************************************//**
+* Beat of an AXI4-Stream port for the CPU model, carries the fields
+* of ap_axiu<64, 0, 0, 0> the kernel uses
+********************************************************************/
+struct packet {
+  unsigned long long data; /**< eight bytes, the first one in the low bits */
+  unsigned char keep;      /**< one bit per valid byte of data */
+  unsigned char last;      /**< 1 on the last beat of a transfer */
+};
+
+#endif
+
+} //namespace fpga
+
+#endif /* STREAM_H_INCLUDED */
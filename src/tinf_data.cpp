@@ -1,37 +1,54 @@
 #include "tinf_data.h"
+#include "backend.h"
 
-unsigned int inf::crc32(const void *data, unsigned int length)
+decltype(&clCreateStream)  inf::Stream::createStream  = NULL;
+decltype(&clReleaseStream) inf::Stream::releaseStream = NULL;
+decltype(&clReadStream)    inf::Stream::readStream    = NULL;
+decltype(&clWriteStream)   inf::Stream::writeStream   = NULL;
+decltype(&clPollStreams)   inf::Stream::pollStreams   = NULL;
+
+int inf::check_integrity(std::vector<std::string> input_list, const inf::options &opt)
 {
-	const unsigned char *buf = (const unsigned char *) data;
-	unsigned int crc = 0xFFFFFFFF;
-	unsigned int i;
+	cl_int ret = inf::TINF_OK;
 
-	if (length == 0) return 0;
+	//Only a test inflates the files, listing reads headers and footers
+	std::unique_ptr<inf::backend> engine;
+	unsigned int workers = omp_get_max_threads();
 
-	for (i = 0; i < length; ++i)
+	if(opt.test)
 	{
-		crc ^= buf[i];
-		crc = inf::tinf_crc32tab[crc & 0x0F] ^ (crc >> 4);
-		crc = inf::tinf_crc32tab[crc & 0x0F] ^ (crc >> 4);
+		engine = inf::open_backend(opt, "fpga_verify");
+		if(!engine || engine->units() == 0) return inf::TINF_FILE_ERROR;
+		workers = engine->units();
 	}
 
-	return crc ^ 0xFFFFFFFF;
-}
+	if(opt.list && opt.listing != NULL) *opt.listing << "compressed\t uncompressed\t ratio\t uncompressed_name\n";
 
-int inf::check_integrity(std::vector<std::string> input_list, ArgumentParser &parser)
-{
-	cl_int ret = inf::TINF_OK;
+	//Largest files first on the unit that finishes them first, idle units steal pending files of busy ones
+	inf::job_scheduler::cost_function cost;
+	if(engine) cost = [&](unsigned int unit, long size, unsigned int isize) { return engine->estimate(unit, size, isize); };
 
-	if(parser.exists("l")) std::cout << "compressed\t uncompressed\t ratio\t uncompressed_name\n";
+	inf::job_scheduler scheduler(input_list, workers, cost);
 
-#pragma omp parallel num_threads(input_list.size())
+#pragma omp parallel num_threads(workers)
 {
-	cl_int err = inf::TINF_OK;
+	unsigned int worker = omp_get_thread_num();
+	std::string input_file;
 
-    std::string  input_file;
-    std::string output_file;
+	while(scheduler.next(worker, input_file))
+	{
+		int err = inf::check_file(input_file, engine.get(), worker, opt);
 
-    input_file = input_list[omp_get_thread_num()];
+		#pragma omp critical
+		if(err != inf::TINF_OK) ret = err;
+	}
+}
+    return ret;
+}
+
+int inf::check_file(const std::string &input_file, inf::backend *engine, unsigned int unit, const inf::options &opt)
+{
+	cl_int err = inf::TINF_OK;
 
 	FILE *fin  = NULL;
 
@@ -42,92 +59,55 @@ int inf::check_integrity(std::vector<std::string> input_list, ArgumentParser &pa
 		err = inf::TINF_FILE_ERROR;
 	}
 
-	//Check header
-	fseek(fin, 0, SEEK_END);
-	unsigned int srclen = ftell(fin);
-	fseek(fin, 0, SEEK_SET);
-	if(srclen < 18)
+	//Check header and read footer
+	inf::gzip_member member = inf::gzip_member();
+	unsigned int buf = err;
+	if(fin != NULL) err = inf::read_gzip_member(fin, member);
+	if(buf != inf::TINF_OK) err = buf;
+	uint64_t srclen = member.srclen;
+
+	//Inflate without output, compare CRC and ISIZE with the footer
+	if(opt.test && err == inf::TINF_OK)
 	{
-		std::cerr << "input too small to be gzip\n";
-		if(err == inf::TINF_OK) err = inf::TINF_DATA_ERROR;
-	}
+		unsigned int crc   = 0;
+		unsigned int isize = 0;
 
-	//Read header
-	std::vector<unsigned char,aligned_allocator<unsigned char>> header(50);
-	if(fread(header.data(), 1, 50, fin) != 50 && err == inf::TINF_OK) err = inf::TINF_FILE_ERROR;
+		err = engine->verify(unit, fin, member, crc, isize);
 
-	//Read footer
-	fseek(fin, -8, SEEK_END);
-	std::vector<unsigned char,aligned_allocator<unsigned char>> footer(8);
-	if(fread(footer.data(), 1,  8, fin) !=  8 && err == inf::TINF_OK) err = inf::TINF_FILE_ERROR;
+		if((crc != member.crc || isize != member.isize) && err == inf::TINF_OK) err = inf::TINF_DATA_ERROR;
+	}
 
-	// Check Header
-    unsigned int dist, time;
-	std::string filename;
-	unsigned int buf = err;
-	err = inf::check_gzip_header(header.data(), srclen, time, dist, filename);
-	if(err != inf::TINF_OK && buf == inf::TINF_OK) err = inf::TINF_DATA_ERROR;
+	if(fin != NULL) fclose(fin);
 
-	if(!parser.exists("q") && err != inf::TINF_OK)
+	if(!opt.quiet && err != inf::TINF_OK)
 	{
 		std::cerr << "process #" << omp_get_thread_num() << " exited with error code " << err << "\n";
-		ret = err;
 	}
 
-	if(parser.exists("l") && err == inf::TINF_OK)
+	if(opt.list && opt.listing != NULL && err == inf::TINF_OK)
 	{
 		//Read output length
-		double olen   = inf::read_le32(&footer.data()[4]);
+		double olen   = member.isize;
 		double ratio;
 		if(olen > srclen) ratio = 1-srclen/olen;
 		else ratio = -olen/double(srclen);
 
-		std::cout << srclen << "\t" << olen << "\t" << ratio*100 << "%\t" << filename << "\n";
+		//One row at a time, the files are checked in parallel
+		#pragma omp critical(listing)
+		*opt.listing << srclen << "\t" << olen << "\t" << ratio*100 << "%\t" << member.filename << "\n";
 	}
-}
-    return ret;
-}
-
-int inf::gzip_uncompress(std::vector<std::string> input_list, ArgumentParser &parser)
-{
-	cl_int ret = inf::TINF_OK;
 
-	std::string binaryFile;
-	if(parser.exists("b")) binaryFile = parser.get<std::string>("b");
-	else                   binaryFile = "../binary_container_1.xclbin";
-    std::vector<cl::Device> devices = inf::get_devices();
-    cl::Device device = devices[0];
-    unsigned fileBufSize;
-    char* fileBuf = inf::read_binary_file(binaryFile, fileBufSize);
-    cl::Program::Binaries bins{{fileBuf, fileBufSize}};
-    devices.resize(1);
-
-    OCL_CHECK(ret, cl::Context context(device, NULL, NULL, NULL, &ret));
-    OCL_CHECK(ret, cl::Program program(context, devices, bins, NULL, &ret));
-    free(fileBuf);
-
-	if(parser.exists("l")) std::cout << "compressed\t uncompressed\t ratio\t uncompressed_name\n";
+	return err;
+}
 
-#pragma omp parallel
+int inf::uncompress_file(const std::string &input_file, inf::backend &engine, unsigned int unit, const inf::options &opt)
 {
-	std::string kernel_name = "fpga_uncompress:{fpga_uncompress_" + std::to_string(omp_get_thread_num()+1) + "}";
-	std::cout << "!!" << kernel_name << "!!\n";
-	OCL_CHECK(ret, cl::Kernel kernel_inflate(program, kernel_name.c_str(), &ret));
-
 	cl_int err = inf::TINF_OK;
 
-    std::string  input_file;
     std::string output_file;
 
-    std::string suff = ".gz";
-    if(parser.exists("S")) suff = parser.get<std::string>("S");
+    const std::string &suff = opt.suffix;
 
-    #pragma omp critical
-    {
-        input_file = input_list[input_list.size()-1];
-        input_list.pop_back();
-    }
-    
     if(input_file.compare(input_file.size()-suff.size(), suff.size(), suff) != 0)
     {
     	std::cerr << "'" << input_file.c_str() << "' has wrong suffix\n";
@@ -144,46 +124,14 @@ int inf::gzip_uncompress(std::vector<std::string> input_list, ArgumentParser &pa
 		if(err == inf::TINF_OK) err = inf::TINF_FILE_ERROR;
 	}
 
-	//Check header
-	fseek(fin, 0, SEEK_END);
-	unsigned int srclen = ftell(fin);
-	fseek(fin, 0, SEEK_SET);
-	if(srclen < 18)
-	{
-		std::cerr << "input too small to be gzip\n";
-		if(err == inf::TINF_OK) err = inf::TINF_DATA_ERROR;
-	}
-
-	//Read header
-	std::vector<unsigned char,aligned_allocator<unsigned char>> header(50);
-	unsigned int actual_size = fread(header.data(), 1, 50, fin);
-	if(actual_size != 50 && err == inf::TINF_OK)
-	{
-		fseek(fin, 0, SEEK_SET);
-		header.resize(actual_size);
-		if(fread(header.data(), 1, actual_size, fin) != actual_size && err == inf::TINF_OK) err = inf::TINF_FILE_ERROR;;
-	}
-
-	//Read footer
-	fseek(fin, -8, SEEK_END);
-	std::vector<unsigned char,aligned_allocator<unsigned char>> footer(8);
-	if(fread(footer.data(), 1,  8, fin) !=  8 && err == inf::TINF_OK) err = inf::TINF_FILE_ERROR;
-
-	//Read output length
-	unsigned int olen   = inf::read_le32(&footer.data()[4]);
-	//Read CRC checksum
-	unsigned int crc32v = inf::read_le32(&footer.data()[0]);
-
-	// Check Header
-    unsigned int dist, time;
-	std::string filename;
+	//Check header and read footer
+	inf::gzip_member member = inf::gzip_member();
 	unsigned int buf = err;
-	err = inf::check_gzip_header(header.data(), srclen, time, dist, filename);
-	if(err != inf::TINF_OK && buf == inf::TINF_OK) err = inf::TINF_DATA_ERROR;
-	std::chrono::system_clock::time_point timestamp = std::chrono::system_clock::from_time_t(time);
-	srclen -= dist; // Subtract header length from input length
-	output_file = filename;
-	if(parser.exists("n") || output_file == "")
+	if(fin != NULL) err = inf::read_gzip_member(fin, member);
+	if(buf != inf::TINF_OK) err = buf;
+	std::chrono::system_clock::time_point timestamp = std::chrono::system_clock::from_time_t(member.time);
+	output_file = member.filename;
+	if(opt.no_name || output_file == "")
 	{
 		output_file = input_file;
 		for(unsigned int i = 0; i < suff.size(); ++i) output_file.pop_back();
@@ -200,9 +148,9 @@ int inf::gzip_uncompress(std::vector<std::string> input_list, ArgumentParser &pa
 	}
 	else
 	{
-		if(!parser.exists("c"))
+		if(!opt.to_stdout)
 		{
-			if(parser.exists("f"))
+			if(opt.force)
 			{
 				if((fout = fopen(output_file.c_str(), "wb")) == NULL)
 				{
@@ -220,175 +168,1239 @@ int inf::gzip_uncompress(std::vector<std::string> input_list, ArgumentParser &pa
 
 	// -- Decompress data --
 	////////////////////////////////////////////////////////////////////////////////////////////////
-    OCL_CHECK(err, cl::CommandQueue q(context, device, CL_QUEUE_PROFILING_ENABLE, &err));
-
-
-    std::vector<unsigned char,aligned_allocator<unsigned char>> dest(100000000);
-    OCL_CHECK(err,
-        cl::Buffer buffer_output(context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, cl::size_type(100000000),     dest.data(),   &err)
-    );
-    std::vector<unsigned int,aligned_allocator<unsigned int>> outlen(1); outlen[0] = olen;
-    OCL_CHECK(err,
-        cl::Buffer buffer_outlen(context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_WRITE, cl::size_type(4),             outlen.data(), &err)
-    );
-    std::vector<unsigned char,aligned_allocator<unsigned char>> source(100000);
-    OCL_CHECK(err,
-        cl::Buffer buffer_input( context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY,  cl::size_type(100000),        source.data(), &err)
-    );
-    std::vector<unsigned int,aligned_allocator<unsigned int>> len(1); len[0] = srclen;
-    OCL_CHECK(err,
-        cl::Buffer buffer_len(   context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_WRITE, cl::size_type(4),             len.data(),    &err)
-    );
-
-    std::vector<unsigned int,aligned_allocator<unsigned int>> tag(1); tag[0] = 0;
-    OCL_CHECK(err,
-        cl::Buffer buffer_tag      (context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_WRITE, cl::size_type(4), tag.data(),      &err)
-    );
-    std::vector<unsigned int,aligned_allocator<unsigned int>> bitcount(1); bitcount[0] = 0;
-    OCL_CHECK(err,
-        cl::Buffer buffer_bitcount (context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_WRITE, cl::size_type(4), bitcount.data(), &err)
-    );
-    std::vector<unsigned int,aligned_allocator<unsigned int>> overflow(1); overflow[0] = 0;
-    OCL_CHECK(err,
-        cl::Buffer buffer_overflow (context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_WRITE, cl::size_type(4), overflow.data(), &err)
-    );
-    std::vector<int,aligned_allocator<int>> bfinal(1);
-    OCL_CHECK(err,
-        cl::Buffer buffer_bfinal (  context, CL_MEM_USE_HOST_PTR | CL_MEM_READ_WRITE, cl::size_type(4), bfinal.data(),   &err)
-    );
-    std::vector<int,aligned_allocator<int>> kernel_error(1);
-    OCL_CHECK(err,
-        cl::Buffer buffer_error (   context, CL_MEM_USE_HOST_PTR | CL_MEM_WRITE_ONLY, cl::size_type(4), kernel_error.data(), &err)
-    );
-
-    size_t narg = 0;
-    OCL_CHECK(err, err = kernel_inflate.setArg(narg++, buffer_output  ));
-    OCL_CHECK(err, err = kernel_inflate.setArg(narg++, buffer_outlen  ));
-    OCL_CHECK(err, err = kernel_inflate.setArg(narg++, buffer_input   ));
-    OCL_CHECK(err, err = kernel_inflate.setArg(narg++, buffer_len     ));
-    OCL_CHECK(err, err = kernel_inflate.setArg(narg++, buffer_tag     ));
-    OCL_CHECK(err, err = kernel_inflate.setArg(narg++, buffer_bitcount));
-    OCL_CHECK(err, err = kernel_inflate.setArg(narg++, buffer_overflow));
-    OCL_CHECK(err, err = kernel_inflate.setArg(narg++, buffer_bfinal  ));
-    OCL_CHECK(err, err = kernel_inflate.setArg(narg++, buffer_error   ));
-
-    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_tag},      0));
-    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_bitcount}, 0));
-    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_overflow}, 0));
-
-    unsigned int crcsum = 0xFFFFFFFF;
-    size_t  input_offset = 0;
-    size_t output_offset = 0;
-    size_t  input_length = 0;
-    size_t output_length = 0;
-    
+    size_t output_total  = 0;
+    inf::pipeline_stats stats = inf::pipeline_stats();
+
+    if(err == inf::TINF_OK) err = engine.inflate(unit, fin, member, fout, opt.to_stdout, output_total, stats);
+
+    if(fin  != NULL) fclose(fin);
+    if(fout != NULL) fclose(fout);
+
+	////////////////////////////////////////////////////////////////////////////////////////////////
+
+	if(!opt.keep && !opt.to_stdout && err == inf::TINF_OK) remove(input_file.c_str());
+
+	//Messages on standard error if the output goes to standard output
+	std::ostream &log = opt.to_stdout ? std::cerr : std::cout;
+
+	if(opt.verbose && stats.kernel.seconds > 0)
+	{
+		#pragma omp critical
+		log << "throughput #" << omp_get_thread_num() << ": read "   << stats.read.bytes   / stats.read.seconds   * 1e-6
+		          << " MB/s, kernel " << stats.kernel.bytes / stats.kernel.seconds * 1e-6
+		          << " MB/s, write "  << stats.write.bytes  / stats.write.seconds  * 1e-6 << " MB/s\n";
+	}
+
+	if(!opt.quiet && err == inf::TINF_OK)
+	{
+		log << "decompressed " << output_total << " bytes from file '" << input_file << "' (#" << omp_get_thread_num() << ") to " << output_file << "\n";
+	}
+	if(!opt.quiet && err != inf::TINF_OK)
+	{
+		std::cerr << "process #" << omp_get_thread_num() << " exited with error code " << err << "\n";
+	}
+
+	if(opt.name) std::filesystem::last_write_time(output_file, timestamp);
+
+	return err;
+}
+
+int inf::uncompress_pipe(FILE *fin, FILE *fout, inf::backend &engine, unsigned int unit, const inf::options &opt)
+{
+	int err = inf::TINF_OK;
+
+	std::vector<unsigned char> rest; //Bytes read ahead
+	size_t output_total = 0;
+	inf::pipeline_stats stats = inf::pipeline_stats();
+	unsigned int members = 0;
+
+	for(;;)
+	{
+		//End of the input after the last member, an empty input is no gzip stream
+		if(rest.empty())
+		{
+			int c = fgetc(fin);
+			if(c == EOF && members == 0)
+			{
+				std::cerr << "unexpected end of file\n";
+				err = inf::TINF_DATA_ERROR;
+			}
+			if(c == EOF) break;
+			rest.push_back(c);
+		}
+
+		inf::gzip_member member = inf::gzip_member();
+		if(inf::read_stream_header(fin, rest, member) != inf::TINF_OK)
+		{
+			if(members == 0)
+			{
+				std::cerr << "input not in gzip format\n";
+				err = inf::TINF_DATA_ERROR;
+			}
+			else if(!opt.quiet) std::cerr << "decompression OK, trailing garbage ignored\n";
+			break;
+		}
+
+		//Buffers of the unit, reset for every member
+		unsigned int crc   = 0;
+		unsigned int isize = 0;
+		err = inf::inflate_buffer(engine.buffers(unit), fin, 0, inf::UNKNOWN_LENGTH, fout, fout == stdout, crc, isize, output_total, stats, &rest);
+		if(err != inf::TINF_OK) break;
+
+		//Footer right after the deflate stream
+		while(rest.size() < 8)
+		{
+			size_t have = rest.size();
+			rest.resize(8);
+			rest.resize(have + fread(rest.data() + have, 1, 8 - have, fin));
+			if(rest.size() == have) break;
+		}
+		if(rest.size() < 8 || crc != inf::read_le32(&rest[0]) || isize != inf::read_le32(&rest[4]))
+		{
+			std::cerr << "decompression failed\n";
+			err = inf::TINF_DATA_ERROR;
+			break;
+		}
+		rest.erase(rest.begin(), rest.begin() + 8);
+		++members;
+	}
+
+	if(opt.verbose && stats.kernel.seconds > 0)
+	{
+		std::cerr << "throughput: read "   << stats.read.bytes   / stats.read.seconds   * 1e-6
+		          << " MB/s, kernel " << stats.kernel.bytes / stats.kernel.seconds * 1e-6
+		          << " MB/s, write "  << stats.write.bytes  / stats.write.seconds  * 1e-6 << " MB/s\n";
+	}
+	if(!opt.quiet && err == inf::TINF_OK)
+	{
+		std::cerr << "decompressed " << output_total << " bytes from standard input\n";
+	}
+	if(!opt.quiet && err != inf::TINF_OK)
+	{
+		std::cerr << "standard input exited with error code " << err << "\n";
+	}
+
+	return err;
+}
+
+int inf::read_stream_header(FILE *fin, std::vector<unsigned char> &rest, inf::gzip_member &member)
+{
+	std::vector<unsigned char> header;
+	size_t used = 0;
+
+	//Next count bytes into the header, from the bytes read ahead first
+	auto take = [&](size_t count) -> bool
+	{
+		for(size_t i = 0; i < count; ++i)
+		{
+			int c = used < rest.size() ? rest[used++] : fgetc(fin);
+			if(c == EOF) return false;
+			header.push_back(c);
+		}
+		return true;
+	};
+	auto take_string = [&]() -> bool
+	{
+		do
+		{
+			if(!take(1)) return false;
+		} while(header.back() != 0);
+		return true;
+	};
+
+	//Length of the header from its flags, then the same checks as for a file
+	bool ok = take(10) && header[0] == 0x1F && header[1] == 0x8B;
+	unsigned char flg = ok ? header[3] : 0;
+
+	if(ok && (flg & inf::FEXTRA))   ok = take(2) && take(inf::read_le16(&header[10]));
+	if(ok && (flg & inf::FNAME))    ok = take_string();
+	if(ok && (flg & inf::FCOMMENT)) ok = take_string();
+	if(ok && (flg & inf::FHCRC))    ok = take(2);
+
+	rest.erase(rest.begin(), rest.begin() + used);
+	if(!ok) return inf::TINF_DATA_ERROR;
+
+	//Room for the footer, which is checked after the stream
+	size_t length = header.size();
+	header.resize(length + 8);
+
+	int err = inf::check_gzip_header(header.data(), header.size(), member.time, member.dist, member.filename);
+	if(err != inf::TINF_OK || member.dist != length) return inf::TINF_DATA_ERROR;
+
+	return inf::TINF_OK;
+}
+
+int inf::read_gzip_member(FILE *fin, inf::gzip_member &member)
+{
+	int err = inf::TINF_OK;
+
+	//Check size
+	fseek(fin, 0, SEEK_END);
+	member.srclen = ftell(fin);
+	fseek(fin, 0, SEEK_SET);
+	if(member.srclen < 18)
+	{
+		std::cerr << "input too small to be gzip\n";
+		return inf::TINF_DATA_ERROR;
+	}
+
+	std::vector<unsigned char,aligned_allocator<unsigned char>> header(50);
+	std::vector<unsigned char,aligned_allocator<unsigned char>> footer(8);
+
+	int fd = inf::io_engine::regular_fd(fin);
+	if(fd >= 0)
+	{
+		//Header and footer of a regular file with one submission
+		inf::io_request probes[2] = {inf::io_request::read(fd, header.data(), 50, 0),
+		                             inf::io_request::read(fd, footer.data(),  8, member.srclen - 8)};
+		inf::io_engine &io = inf::io_engine::shared();
+		io.submit(probes, 2);
+		io.wait(probes, 2);
+
+		if(probes[0].result < 0 || probes[1].result != 8) return inf::TINF_FILE_ERROR;
+		header.resize(probes[0].result);
+	}
+	else
+	{
+		//Read header
+		unsigned int actual_size = fread(header.data(), 1, 50, fin);
+		if(actual_size != 50) header.resize(actual_size);
+
+		//Read footer
+		fseek(fin, -8, SEEK_END);
+		if(fread(footer.data(), 1,  8, fin) !=  8) return inf::TINF_FILE_ERROR;
+	}
+
+	member.crc   = inf::read_le32(&footer.data()[0]);
+	member.isize = inf::read_le32(&footer.data()[4]);
+
+	//Check header
+	err = inf::check_gzip_header(header.data(), member.srclen, member.time, member.dist, member.filename);
+	if(err != inf::TINF_OK) return inf::TINF_DATA_ERROR;
+
+	return err;
+}
+
+int inf::inflate_member(inf::cu_buffers &cu, FILE *fin, const inf::gzip_member &member, FILE *fout, bool to_stdout,
+                        size_t &output_total, inf::pipeline_stats &stats)
+{
+	int err = inf::TINF_OK;
+    unsigned int crc     = 0;
+    unsigned int isize   = 0;
+    uint64_t length      = member.srclen - member.dist - 8;
+
+    //Streaming kernel if the platform and the device binary provide it, else the buffer kernel
+	if(cu.has_stream && length < UINT_MAX)
+		err = inf::inflate_stream(cu, fin, member.dist, length, fout, to_stdout, crc, isize, output_total);
+	else
+		err = inf::inflate_buffer(cu, fin, member.dist, length, fout, to_stdout, crc, isize, output_total, stats);
+
+	if((crc != member.crc || isize != member.isize) && err == inf::TINF_OK) err = inf::TINF_DATA_ERROR; //Check CRC and ISIZE computed by the kernel
+
+	return err;
+}
+
+int inf::inflate_buffer(inf::cu_buffers &cu, FILE *fin, long offset, uint64_t length, FILE *fout, bool to_stdout,
+                        unsigned int &crc, unsigned int &isize, size_t &output_total,
+                        inf::pipeline_stats &stats, std::vector<unsigned char> *rest)
+{
+	cl_int err = inf::TINF_OK;
+
+    std::vector<inf::pipeline_slot> &slots = cu.slots;
+    std::vector<fpga::tinf_state,aligned_allocator<fpga::tinf_state>> &state = cu.state;
+    std::vector<fpga::tinf_history,aligned_allocator<fpga::tinf_history>> &history = cu.history;
+
+#ifndef INF_LOCAL_STREAM
+    cl::CommandQueue &q = cu.q;
+    cl::Kernel &kernel_inflate = cu.kernel_inflate;
+    cl::Buffer &buffer_state   = cu.buffer_state;
+    cl::Buffer &buffer_history = cu.buffer_history;
+
+    cl::Event history_event;
+    cl::Event kernel_event;
+    if(!cu.host)
+    {
+    	OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_history}, 0, NULL, &history_event));
+    	kernel_event = history_event;
+    }
+#endif
+
+    std::mutex lock;
+    std::condition_variable changed;
+
+    // -- Read stage: file to chunks of at most INPUT_WINDOW bytes --
+    std::deque<std::vector<unsigned char>> chunks;
+    bool read_done = false;
+    bool stop      = false;
+    int  read_err  = inf::TINF_OK;
+
+    //A stream of unknown length is read from the current position until the end of the file, after the bytes read ahead
+    bool streamed = length == inf::UNKNOWN_LENGTH;
+    if(streamed && rest != NULL && !rest->empty()) chunks.push_back(std::move(*rest));
+
+    //A regular file is read by the kernel stage straight from its mapping, without a read stage
+    inf::mapped_file map(streamed ? NULL : fin, offset, streamed ? 0 : length);
+    size_t mapped_end = 0;
+    if(map.mapped()) read_done = true;
+
+    std::thread reader;
+    if(!map.mapped()) reader = std::thread([&]()
+    {
+    	uint64_t read_offset = 0;
+    	bool eof = false;
+
+    	if(!streamed) fseek(fin, offset, SEEK_SET);
+    	while(!eof && (streamed || read_offset < length))
+    	{
+    		{
+    			std::unique_lock<std::mutex> guard(lock);
+    			changed.wait(guard, [&]() { return stop || chunks.size() < inf::PIPELINE_DEPTH; });
+    			if(stop) break;
+    		}
+
+    		std::vector<unsigned char> chunk(streamed ? inf::INPUT_WINDOW : min(inf::INPUT_WINDOW, length - read_offset));
+    		double start = omp_get_wtime();
+    		size_t got = fread(chunk.data(), 1, chunk.size(), fin);
+    		bool ok = got == chunk.size();
+    		if(streamed)
+    		{
+    			//A short read is the end of the stream, unless it failed
+    			eof = !ok;
+    			ok  = !ferror(fin);
+    			chunk.resize(got);
+    		}
+    		stats.read.seconds += omp_get_wtime() - start;
+    		stats.read.bytes   += chunk.size();
+    		read_offset        += chunk.size();
+
+    		std::lock_guard<std::mutex> guard(lock);
+    		if(!ok) read_err = inf::TINF_FILE_ERROR;
+    		if(!chunk.empty()) chunks.push_back(std::move(chunk));
+    		changed.notify_all();
+    	}
+
+    	std::lock_guard<std::mutex> guard(lock);
+    	read_done = true;
+    	changed.notify_all();
+    });
+
+    // -- Write stage: output of finished runs, oldest first --
+    std::deque<size_t> written;
+    int write_err = inf::TINF_OK;
+
+    //A regular file is written through the I/O engine at its offset, the outputs of all finished runs in one batch
+    int out_fd = to_stdout ? -1 : inf::io_engine::regular_fd(fout);
+    off_t out_offset = 0;
+    if(out_fd >= 0)
+    {
+    	fflush(fout);
+    	out_offset = ftello(fout);
+    }
+
+    std::thread writer([&]()
+    {
+    	inf::io_engine &io = inf::io_engine::shared();
+
+    	for(;;)
+    	{
+    		std::vector<size_t> ready;
+    		{
+    			std::unique_lock<std::mutex> guard(lock);
+    			changed.wait(guard, [&]() { return stop || !written.empty(); });
+    			if(written.empty()) break;
+    			ready.assign(written.begin(), written.end());
+    		}
+
+    		double start = omp_get_wtime();
+    		std::vector<inf::io_request> requests;
+    		for(size_t i = 0; i < ready.size(); ++i)
+    		{
+    			inf::pipeline_slot &s = slots[ready[i]];
+#ifndef INF_LOCAL_STREAM
+    			if(!cu.host)
+    			{
+    				cl_int ev_err;
+    				OCL_CHECK(ev_err, ev_err = s.done.wait());
+    				if(ev_err != CL_SUCCESS) write_err = inf::TINF_FILE_ERROR;
+    			}
+#endif
+    			if(out_fd < 0) inf::write_output(s.dest.data(), s.length, fout, to_stdout);
+    			else if(s.length > 0)
+    			{
+    				requests.push_back(inf::io_request::write(out_fd, s.dest.data(), s.length, out_offset));
+    				out_offset += s.length;
+    			}
+    			stats.write.bytes += s.length;
+    		}
+    		if(!io.run(requests.data(), requests.size())) write_err = inf::TINF_FILE_ERROR;
+    		stats.write.seconds += omp_get_wtime() - start;
+
+    		std::lock_guard<std::mutex> guard(lock);
+    		for(size_t i = 0; i < ready.size(); ++i)
+    		{
+    			written.pop_front();
+    			slots[ready[i]].busy = false;
+    		}
+    		changed.notify_all();
+    	}
+    });
+
+    // -- Kernel stage: one run per input window, the next run needs the state of the last one --
+    std::vector<unsigned char> carry; //Unused rest of the last input window
+    size_t input_offset = 0;
+    size_t run = 0;
+
     do
     {
-    	if(len[0] < 8 && err == inf::TINF_OK) err = inf::TINF_DATA_ERROR; //Error if rest length smaller than 8 bytes of footer
-
-    	std::cout << "buffer input offset: "  <<  input_offset << "\n";
-    	std::cout << "buffer output offset: " << output_offset << "\n";
-
-    	//Copy to device
-    	input_length = min(100000, len[0] - 8); //Calculate length of input: rest or 100 MB
-    	fseek(fin, dist + input_offset, SEEK_SET);
-    	fread(source.data(), 1, input_length, fin);
-    	fseek(fout, output_offset, SEEK_SET);
-    	_cl_buffer_region sub_buffer_input_region{0, input_length};
-	    OCL_CHECK(err,
-	        cl::Buffer sub_buffer_input = buffer_input.createSubBuffer(CL_MEM_READ_ONLY, CL_BUFFER_CREATE_TYPE_REGION, &sub_buffer_input_region, &err)
-        );
-	    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({sub_buffer_input}, 0));
-    	//OCL_CHECK(err, err = q.enqueueWriteBuffer(buffer_input, CL_FALSE, 0, input_length, source.data()));
-	
-	    OCL_CHECK(err, q.finish());
-
-    	OCL_CHECK(err, err = q.enqueueTask(kernel_inflate)); //Execute kernel
-
-	    OCL_CHECK(err, q.finish());
-
-	    cl::Event copy_outlen_event;
-    	OCL_CHECK(err, err = q.enqueueMigrateMemObjects(
-    			{buffer_error,   //Get error on kernel_error[0]
-    			buffer_len,     //Get rest length of  input in "len[0]"
-				buffer_outlen,  //Get rest length of output in "outlen[0]"
-				buffer_bfinal}, //In last block bfinal[0] is 1
-				CL_MIGRATE_MEM_OBJECT_HOST, NULL, &copy_outlen_event));
-    	OCL_CHECK(err, copy_outlen_event.wait());
-    	OCL_CHECK(err, q.finish());
-
-    	std::cout << "test: " << outlen[0] << "\n";
-
-    	//Copy to host
-    	output_length = (olen - outlen[0]) - output_offset;
-    	std::cout << "buffer output size: " << output_length << "\n";
-
-    	_cl_buffer_region sub_buffer_output_region{0, output_length};
-	    OCL_CHECK(err,
-	        cl::Buffer sub_buffer_output = buffer_output.createSubBuffer(CL_MEM_WRITE_ONLY, CL_BUFFER_CREATE_TYPE_REGION, &sub_buffer_output_region, &err)
-        );
-	    cl::Event copy_dest_event;
-	    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({sub_buffer_output}, CL_MIGRATE_MEM_OBJECT_HOST, NULL, &copy_dest_event));
-	    OCL_CHECK(err, copy_dest_event.wait());
-	    OCL_CHECK(err, q.finish());
-    	//OCL_CHECK(err, err = q.enqueueReadBuffer(buffer_output, CL_FALSE, 0, output_length, dest.data()));  OCL_CHECK(err, q.finish());
-	
-    	if(parser.exists("c"))
+    	if(!streamed && input_offset > length && err == inf::TINF_OK) err = inf::TINF_DATA_ERROR; //Error if the footer was consumed
+    	if(err != inf::TINF_OK) break;
+
+    	inf::pipeline_slot &s = slots[run % slots.size()];
+    	unsigned char *source = s.source.data();
+    	unsigned int input_length = 0;
     	{
-    		for(unsigned int s = 0; s < output_length; ++s) std::cout << dest.data()[s];
+    		//Wait until the output of the slot has been written, then fill its input window
+    		std::unique_lock<std::mutex> guard(lock);
+    		changed.wait(guard, [&]() { return !s.busy; });
+    	}
+
+    	if(map.mapped())
+    	{
+    		//The window starts at the first byte not consumed yet, the rest of the last one is not copied
+    		double start = omp_get_wtime();
+    		input_length = min(inf::INPUT_WINDOW, length - input_offset);
+    		const unsigned char *window = map.window(input_offset, input_length);
+
+    		if(window == NULL) err = inf::TINF_FILE_ERROR;
+    		else if(cu.host) source = const_cast<unsigned char *>(window); //The kernel code reads the mapping itself
+    		else std::copy(window, window + input_length, s.source.begin());
+
+    		stats.read.seconds += omp_get_wtime() - start;
+    		if(input_offset + input_length > mapped_end)
+    		{
+    			stats.read.bytes += input_offset + input_length - mapped_end;
+    			mapped_end = input_offset + input_length;
+    		}
     	}
     	else
     	{
-    		fwrite(dest.data(), 1, output_length, fout);
+    		std::unique_lock<std::mutex> guard(lock);
+
+    		std::copy(carry.begin(), carry.end(), s.source.begin());
+    		input_length = carry.size();
+
+    		while(input_length < inf::INPUT_WINDOW)
+    		{
+    			changed.wait(guard, [&]() { return read_done || !chunks.empty(); });
+    			if(chunks.empty()) break;
+
+    			std::vector<unsigned char> &chunk = chunks.front();
+    			unsigned int take = min(chunk.size(), inf::INPUT_WINDOW - input_length);
+    			std::copy(chunk.begin(), chunk.begin() + take, s.source.begin() + input_length);
+    			chunk.erase(chunk.begin(), chunk.begin() + take);
+    			if(chunk.empty()) chunks.pop_front();
+    			input_length += take;
+    		}
+    		changed.notify_all();
+
+    		if(read_err != inf::TINF_OK) err = read_err;
     	}
+    	if(err != inf::TINF_OK) break;
 
-    	//Get offsets
-    	output_offset = olen - outlen[0];
-    	 input_offset = srclen -  len[0];
+    	unsigned int mode = state[0].mode;
+
+    	if(cu.host)
+    	{
+    		//The kernel code on host memory
+    		double start = omp_get_wtime();
+    		fpga_uncompress(s.dest.data(), inf::OUTPUT_CHUNK, source, input_length, state.data(), history.data());
+    		stats.kernel.seconds += omp_get_wtime() - start;
+    	}
+#ifndef INF_LOCAL_STREAM
+    	else
+    	{
+	    	//Input window and state to the device, the run waits for them and for the last run
+	    	cl::Buffer &view = s.views[input_length > 0 ? (input_length - 1) / inf::VIEW_SIZE : 0];
+		    cl::Event input_event;
+		    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({view, buffer_state}, 0, NULL, &input_event));
+
+		    OCL_CHECK(err, err = kernel_inflate.setArg(0, s.buffer_output));
+		    OCL_CHECK(err, err = kernel_inflate.setArg(2, s.buffer_input ));
+		    OCL_CHECK(err, err = kernel_inflate.setArg(3, (unsigned int)(input_length)));
+
+		    std::vector<cl::Event> kernel_wait = {input_event, kernel_event};
+	    	OCL_CHECK(err, err = q.enqueueTask(kernel_inflate, &kernel_wait, &kernel_event)); //Execute kernel: inflates as far as the window reaches
+
+		    std::vector<cl::Event> state_wait = {kernel_event};
+		    cl::Event copy_state_event;
+	    	OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_state}, CL_MIGRATE_MEM_OBJECT_HOST, &state_wait, &copy_state_event));
+	    	OCL_CHECK(err, copy_state_event.wait());
+
+	    	cl_ulong kernel_start = kernel_event.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+	    	cl_ulong kernel_end   = kernel_event.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+	    	stats.kernel.seconds += (kernel_end - kernel_start) * 1e-9;
+    	}
+#endif
 
     	//Check kernel errors
-    	std::cout << kernel_error[0] << " " << bfinal[0] << "\n\n";
-    	if(kernel_error[0] != inf::TINF_OK && err == inf::TINF_OK)
+    	if(state[0].err != inf::TINF_OK && err == inf::TINF_OK)
+    	{
+    		std::cerr << "decompression failed\n";
+    		err = state[0].err;
+    		break;
+    	}
+    	if(!state[0].bfinal && state[0].blocks == 0 && state[0].src_used == 0 && state[0].dst_used == 0
+    	   && state[0].mode == mode && err == inf::TINF_OK)
     	{
+    		//No progress at all: truncated input
     		std::cerr << "decompression failed\n";
-    		err = kernel_error[0];
+    		err = inf::TINF_DATA_ERROR;
     		break;
     	}
+    	stats.kernel.bytes += state[0].src_used;
 
-    	//Do CRC partially
-    	for(size_t i = 0; i < output_offset; ++i)
+    	//Output back to the host and to the write stage, the next run does not wait for it
+    	s.length = state[0].dst_used;
+#ifndef INF_LOCAL_STREAM
+    	if(!cu.host && s.length > 0)
     	{
-    		crcsum ^= dest.data()[i];
-    		crcsum = tinf_crc32tab[crcsum & 0x0F] ^ (crcsum >> 4);
-    		crcsum = tinf_crc32tab[crcsum & 0x0F] ^ (crcsum >> 4);
+    		std::vector<cl::Event> read_wait = {kernel_event};
+    		OCL_CHECK(err, err = q.enqueueReadBuffer(s.buffer_output, CL_FALSE, 0, s.length, s.dest.data(), &read_wait, &s.done));
+    	}
+    	else if(!cu.host) s.done = kernel_event;
+#endif
+    	{
+    		std::lock_guard<std::mutex> guard(lock);
+    		s.busy = true;
+    		written.push_back(run % slots.size());
+    		changed.notify_all();
     	}
 
-    }while(!bfinal[0]);
+    	//Get offsets
+    	output_total += s.length;
+    	input_offset += state[0].src_used;
+    	if(!map.mapped()) carry.assign(s.source.begin() + state[0].src_used, s.source.begin() + input_length);
+    	++run;
 
-    fclose(fin);
-    fclose(fout);
-    if(!parser.exists("k")) remove(input_list[0].c_str());
+    }while(!state[0].bfinal);
 
-    crcsum ^= 0xFFFFFFFF;
+    //Drain the write stage, stop the read stage
+    {
+    	std::lock_guard<std::mutex> guard(lock);
+    	stop = true;
+    	changed.notify_all();
+    }
+    if(reader.joinable()) reader.join();
+    writer.join();
+    if(err == inf::TINF_OK) err = write_err;
+    if(out_fd >= 0) fseeko(fout, out_offset, SEEK_SET); //Later writes of fout follow the output
 
-	////////////////////////////////////////////////////////////////////////////////////////////////
+    //Bytes read past the end of the deflate stream: the footer and what follows it
+    if(streamed && rest != NULL)
+    {
+    	rest->assign(carry.begin(), carry.end());
+    	for(size_t i = 0; i < chunks.size(); ++i) rest->insert(rest->end(), chunks[i].begin(), chunks[i].end());
+    }
+
+#ifndef INF_LOCAL_STREAM
+    //Read CRC and ISIZE of the output back
+    if(!cu.host)
+    {
+    	std::vector<cl::Event> history_wait = {kernel_event};
+    	OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_history}, CL_MIGRATE_MEM_OBJECT_HOST, &history_wait, &history_event));
+    	OCL_CHECK(err, err = history_event.wait());
+    }
+#endif
+    crc   = history[0].crc;
+    isize = history[0].isize;
+
+    return err;
+}
+
+int inf::inflate_stream(inf::cu_buffers &cu, FILE *fin, long offset, uint64_t length, FILE *fout, bool to_stdout,
+                        unsigned int &crc, unsigned int &isize, size_t &output_total)
+{
+	int err = inf::TINF_OK;
+
+    std::vector<unsigned char,aligned_allocator<unsigned char>> &dest = cu.slots[0].dest;
+    std::vector<fpga::tinf_state,aligned_allocator<fpga::tinf_state>> &state = cu.state;
+    std::vector<fpga::tinf_history,aligned_allocator<fpga::tinf_history>> &history = cu.history;
+
+    inf::stream_port input, output;
+
+#ifdef INF_LOCAL_STREAM
+    //CPU-only stand-in: the kernel model runs in a thread of its own behind local streams
+    fpga::stream<fpga::packet, fpga::TINF_WORD_DEPTH> local_input, local_output;
+    input.local  = &local_input;
+    output.local = &local_output;
+
+    std::thread run(fpga_uncompress_stream, std::ref(local_output), (unsigned int)(inf::OUTPUT_CHUNK),
+                    std::ref(local_input), (unsigned int)(length), state.data(), history.data());
+#else
+    cl_int cl_err;
+
+    cl::CommandQueue &q = cu.q;
+    cl::Kernel &kernel_stream  = cu.kernel_stream;
+    cl::Buffer &buffer_state   = cu.buffer_state;
+    cl::Buffer &buffer_history = cu.buffer_history;
+    cl::Device &device         = cu.device;
+
+    //Arguments 0 (dest) and 2 (source) are streams, they are not set
+    OCL_CHECK(cl_err, cl_err = kernel_stream.setArg(1, (unsigned int)(inf::OUTPUT_CHUNK)));
+    OCL_CHECK(cl_err, cl_err = kernel_stream.setArg(3, (unsigned int)(length)));
+    OCL_CHECK(cl_err, cl_err = kernel_stream.setArg(4, buffer_state  ));
+    OCL_CHECK(cl_err, cl_err = kernel_stream.setArg(5, buffer_history));
+
+    cl_mem_ext_ptr_t ext;
+    ext.param = kernel_stream.get();
+    ext.obj   = NULL;
+
+    ext.flags = 0;
+    OCL_CHECK(cl_err, output.stream = inf::Stream::createStream(device.get(), XCL_STREAM_WRITE_ONLY, CL_STREAM, &ext, &cl_err));
+    ext.flags = 2;
+    OCL_CHECK(cl_err, input.stream  = inf::Stream::createStream(device.get(), XCL_STREAM_READ_ONLY,  CL_STREAM, &ext, &cl_err));
+    input.device = output.device = device.get();
+
+    cl::Event records_event;
+    OCL_CHECK(cl_err, cl_err = q.enqueueMigrateMemObjects({buffer_state, buffer_history}, 0, NULL, &records_event));
+    std::vector<cl::Event> kernel_wait = {records_event};
+    OCL_CHECK(cl_err, cl_err = q.enqueueTask(kernel_stream, &kernel_wait)); //Execute kernel: inflates the whole deflate stream
+#endif
+
+    //Push input from a thread of its own, such that output is pulled meanwhile
+    int push_err = inf::TINF_OK;
+    std::thread push([&]()
+    {
+    	std::vector<unsigned char,aligned_allocator<unsigned char>> source(inf::INPUT_WINDOW);
+    	uint64_t input_offset = 0;
+
+    	//A regular file is pushed from its mapping
+    	inf::mapped_file map(fin, offset, length);
+    	if(!map.mapped()) fseek(fin, offset, SEEK_SET);
+
+    	while(input_offset < length)
+    	{
+    		unsigned int input_length = min(inf::INPUT_WINDOW, length - input_offset);
+    		const unsigned char *window = source.data();
+
+    		//The window is pushed anyway, the kernel waits for length bytes
+    		if(map.mapped())
+    		{
+    			const unsigned char *mapped = map.window(input_offset, input_length);
+    			if(mapped == NULL) push_err = inf::TINF_FILE_ERROR;
+#ifdef INF_LOCAL_STREAM
+    			else window = mapped;
+#else
+    			else std::copy(mapped, mapped + input_length, source.begin()); //DMA from the aligned window
+#endif
+    		}
+    		else if(fread(source.data(), 1, input_length, fin) != input_length) push_err = inf::TINF_FILE_ERROR;
+
+    		input_offset += input_length;
+    		inf::stream_write(input, window, input_length, input_offset == length);
+    	}
+    });
+
+    //Pull segments until the final one, every segment ends with a trailer word
+    for(;;)
+    {
+    	unsigned int segment = inf::stream_read(output, dest.data(), inf::OUTPUT_CHUNK);
+    	if(segment < 8 || segment % 8 != 0)
+    	{
+    		std::cerr << "stream transfer failed\n";
+    		err = inf::TINF_DATA_ERROR;
+    		break;
+    	}
+
+    	unsigned int output_length = inf::read_le32(dest.data() + segment - 8);
+    	unsigned int final         = inf::read_le32(dest.data() + segment - 4);
+
+    	inf::write_output(dest.data(), min(output_length, segment - 8), fout, to_stdout);
+    	output_total += output_length;
+
+    	if(final) break;
+    }
+
+    push.join();
+
+#ifdef INF_LOCAL_STREAM
+    run.join();
+#else
+    OCL_CHECK(cl_err, cl_err = q.finish());
+    OCL_CHECK(cl_err, cl_err = q.enqueueMigrateMemObjects({buffer_state, buffer_history}, CL_MIGRATE_MEM_OBJECT_HOST));
+    OCL_CHECK(cl_err, cl_err = q.finish()); //The queue is out of order, finish orders the migration after the kernel
+
+    inf::Stream::releaseStream(input.stream);
+    inf::Stream::releaseStream(output.stream);
+#endif
+
+    //Check kernel errors
+    if(err == inf::TINF_OK) err = push_err;
+    if(err == inf::TINF_OK && state[0].err != inf::TINF_OK)
+    {
+    	std::cerr << "decompression failed\n";
+    	err = state[0].err;
+    }
+    if(err == inf::TINF_OK && !state[0].bfinal)
+    {
+    	//Truncated input, or output beyond the 4 GiB limit of a streaming run
+    	std::cerr << "decompression failed\n";
+    	err = state[0].dst_used == UINT_MAX ? inf::TINF_BUF_ERROR : inf::TINF_DATA_ERROR;
+    }
+
+    crc   = history[0].crc;
+    isize = history[0].isize;
+
+    return err;
+}
+
+int inf::verify_buffer(inf::cu_buffers &cu, FILE *fin, long offset, uint64_t length,
+                       unsigned int &crc, unsigned int &isize)
+{
+	cl_int err = inf::TINF_OK;
+
+    std::vector<unsigned char,aligned_allocator<unsigned char>> &source = cu.slots[0].source;
+    std::vector<fpga::tinf_state,aligned_allocator<fpga::tinf_state>> &state = cu.state;
+    std::vector<fpga::tinf_history,aligned_allocator<fpga::tinf_history>> &history = cu.history;
+
+#ifndef INF_LOCAL_STREAM
+    cl::CommandQueue &q = cu.q;
+    cl::Kernel &kernel_verify  = cu.kernel_verify;
+    cl::Buffer &buffer_state   = cu.buffer_state;
+    cl::Buffer &buffer_history = cu.buffer_history;
+
+    cl::Event kernel_event;
+    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_state, buffer_history}, 0, NULL, &kernel_event));
+#endif
+
+    size_t input_offset = 0;
+    unsigned int input_length = 0;
+
+    //A regular file is read straight from its mapping
+    inf::mapped_file map(fin, offset, length);
+
+    // -- Read stage of all other files: chunks of at most INPUT_WINDOW bytes, read while the kernel runs --
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::vector<unsigned char>> chunks;
+    bool read_done = false;
+    bool stop      = false;
+    int  read_err  = inf::TINF_OK;
+
+    std::thread reader;
+    if(!map.mapped()) reader = std::thread([&]()
+    {
+    	uint64_t read_offset = 0;
+
+    	fseek(fin, offset, SEEK_SET);
+    	while(read_offset < length)
+    	{
+    		{
+    			std::unique_lock<std::mutex> guard(lock);
+    			changed.wait(guard, [&]() { return stop || chunks.size() < inf::PIPELINE_DEPTH; });
+    			if(stop) break;
+    		}
+
+    		std::vector<unsigned char> chunk(min(inf::INPUT_WINDOW, length - read_offset));
+    		bool ok = fread(chunk.data(), 1, chunk.size(), fin) == chunk.size();
+    		read_offset += chunk.size();
+
+    		std::lock_guard<std::mutex> guard(lock);
+    		if(!ok) read_err = inf::TINF_FILE_ERROR;
+    		chunks.push_back(std::move(chunk));
+    		changed.notify_all();
+    		if(!ok) break;
+    	}
+
+    	std::lock_guard<std::mutex> guard(lock);
+    	read_done = true;
+    	changed.notify_all();
+    });
+
+    do
+    {
+    	if(input_offset > length && err == inf::TINF_OK) err = inf::TINF_DATA_ERROR; //Error if the footer was consumed
+    	if(err != inf::TINF_OK) break;
+
+    	unsigned char *input = source.data();
+
+    	if(map.mapped())
+    	{
+    		//The window starts at the first byte not consumed yet, the pages ahead are read by the kernel meanwhile
+    		input_length = min(inf::INPUT_WINDOW, length - input_offset);
+    		const unsigned char *window = map.window(input_offset, input_length);
+    		if(window == NULL)
+    		{
+    			err = inf::TINF_FILE_ERROR;
+    			break;
+    		}
+#ifdef INF_LOCAL_STREAM
+    		input = const_cast<unsigned char *>(window); //The kernel model reads host memory
+#else
+    		std::copy(window, window + input_length, input);
+#endif
+    	}
+    	else
+    	{
+    		//Fill the input window: the unused rest of the last one is at its begin, then chunks of the read stage
+    		std::unique_lock<std::mutex> guard(lock);
+    		while(input_length < inf::INPUT_WINDOW)
+    		{
+    			changed.wait(guard, [&]() { return read_done || !chunks.empty(); });
+    			if(chunks.empty()) break;
+
+    			std::vector<unsigned char> &chunk = chunks.front();
+    			unsigned int take = min(chunk.size(), inf::INPUT_WINDOW - input_length);
+    			std::copy(chunk.begin(), chunk.begin() + take, source.begin() + input_length);
+    			chunk.erase(chunk.begin(), chunk.begin() + take);
+    			if(chunk.empty()) chunks.pop_front();
+    			input_length += take;
+    		}
+    		changed.notify_all();
+
+    		if(read_err != inf::TINF_OK) err = read_err;
+    		if(err != inf::TINF_OK) break;
+    	}
+
+    	unsigned int mode = state[0].mode;
+
+#ifdef INF_LOCAL_STREAM
+    	fpga_verify(input, input_length, state.data(), history.data());
+#else
+    	//The smallest view that covers the window, the run waits for it and for the last run
+    	cl::Buffer &view = cu.slots[0].views[input_length > 0 ? (input_length - 1) / inf::VIEW_SIZE : 0];
+	    cl::Event input_event;
+	    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({view}, 0, NULL, &input_event));
+	    OCL_CHECK(err, err = kernel_verify.setArg(1, (unsigned int)(input_length)));
+
+	    std::vector<cl::Event> kernel_wait = {input_event, kernel_event};
+    	OCL_CHECK(err, err = q.enqueueTask(kernel_verify, &kernel_wait, &kernel_event)); //Execute kernel: inflates as far as the window reaches
+
+	    std::vector<cl::Event> state_wait = {kernel_event};
+	    cl::Event copy_state_event;
+    	OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_state}, CL_MIGRATE_MEM_OBJECT_HOST, &state_wait, &copy_state_event));
+    	OCL_CHECK(err, copy_state_event.wait());
+#endif
+
+    	//Check kernel errors
+    	if(state[0].err != inf::TINF_OK && err == inf::TINF_OK)
+    	{
+    		err = state[0].err;
+    		break;
+    	}
+    	if(!state[0].bfinal && state[0].blocks == 0 && state[0].src_used == 0 && state[0].dst_used == 0
+    	   && state[0].mode == mode && err == inf::TINF_OK)
+    	{
+    		//No progress at all: truncated input
+    		err = inf::TINF_DATA_ERROR;
+    		break;
+    	}
+
+    	//Keep the unused rest of the window for the next run
+    	if(!map.mapped()) std::copy(source.begin() + state[0].src_used, source.begin() + input_length, source.begin());
+    	input_length -= state[0].src_used;
+    	input_offset += state[0].src_used;
+
+    }while(!state[0].bfinal);
+
+    //Stop the read stage
+    {
+    	std::lock_guard<std::mutex> guard(lock);
+    	stop = true;
+    	changed.notify_all();
+    }
+    if(reader.joinable()) reader.join();
+
+#ifndef INF_LOCAL_STREAM
+    //Read CRC and ISIZE of the output back
+    OCL_CHECK(err, err = q.enqueueMigrateMemObjects({buffer_history}, CL_MIGRATE_MEM_OBJECT_HOST));
+    OCL_CHECK(err, err = q.finish());
+#endif
+    crc   = history[0].crc;
+    isize = history[0].isize;
+
+    return err;
+}
+
+inf::cu_buffers::cu_buffers(cl::Context &context, cl::Device &device, cl::Program &program,
+                            const inf::compute_unit &inflate, const inf::compute_unit &stream, unsigned int depth)
+  : slots(depth), state(1), history(1)
+{
+	has_stream = inf::open_stream_kernel(program, stream.name(), kernel_stream);
+
+#ifndef INF_LOCAL_STREAM
+	host = false;
+	cl_int err;
 
-	if(crc32v    != crcsum && err == inf::TINF_OK) err = inf::TINF_DATA_ERROR; //Check CRC
-	if(outlen[0] != 0      && err == inf::TINF_OK) err = inf::TINF_DATA_ERROR; //Rest length must be zero
+	this->device = device;
+	//Commands are ordered by their events only
+	OCL_CHECK(err, q = cl::CommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE | CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, &err));
+	OCL_CHECK(err, kernel_inflate = cl::Kernel(program, inflate.name().c_str(), &err));
 
-	if(!parser.exists("q") && err == inf::TINF_OK)
+	//Buffers in the banks of arguments 0 (dest), 2 (source), 4 (state) and 5 (history)
+	for(size_t i = 0; i < slots.size(); ++i)
 	{
-		std::cout << "decompressed " << olen << " bytes from file '" << input_file << "' (#" << omp_get_thread_num() << ") to " << output_file << "\n";
+		OCL_CHECK(err,
+		    slots[i].buffer_output = inf::bank_buffer(context, CL_MEM_WRITE_ONLY, inf::OUTPUT_CHUNK, slots[i].dest.data(), inflate.bank(0), &err)
+		);
+		OCL_CHECK(err,
+		    slots[i].buffer_input  = inf::bank_buffer(context, CL_MEM_READ_ONLY,  inf::INPUT_WINDOW, slots[i].source.data(), inflate.bank(2), &err)
+		);
+
+		add_views(slots[i]);
 	}
-	if(!parser.exists("q") && err != inf::TINF_OK)
+	OCL_CHECK(err,
+	    buffer_state   = inf::bank_buffer(context, CL_MEM_READ_WRITE, sizeof(fpga::tinf_state), state.data(), inflate.bank(4), &err)
+	);
+	OCL_CHECK(err,
+	    buffer_history = inf::bank_buffer(context, CL_MEM_READ_WRITE, sizeof(fpga::tinf_history), history.data(), inflate.bank(5), &err)
+	);
+
+	//Arguments that stay the same for every run
+	OCL_CHECK(err, err = kernel_inflate.setArg(1, (unsigned int)(inf::OUTPUT_CHUNK)));
+	OCL_CHECK(err, err = kernel_inflate.setArg(4, buffer_state  ));
+	OCL_CHECK(err, err = kernel_inflate.setArg(5, buffer_history));
+#else
+	//The kernel model stands in for the device
+	host = true;
+	(void) context;
+	(void) device;
+	(void) inflate;
+#endif
+
+	reset();
+}
+
+inf::cu_buffers::cu_buffers(cl::Context &context, cl::Device &device, cl::Program &program, const inf::compute_unit &verify)
+  : slots(1), state(1), history(1), has_stream(false)
+{
+	//Input only, the kernel writes no output
+	slots[0].dest = std::vector<unsigned char,aligned_allocator<unsigned char>>();
+
+#ifndef INF_LOCAL_STREAM
+	host = false;
+	cl_int err;
+
+	this->device = device;
+	OCL_CHECK(err, q = cl::CommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE | CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, &err));
+	OCL_CHECK(err, kernel_verify = cl::Kernel(program, verify.name().c_str(), &err));
+
+	//Buffers in the banks of arguments 0 (source), 2 (state) and 3 (history)
+	OCL_CHECK(err,
+	    slots[0].buffer_input = inf::bank_buffer(context, CL_MEM_READ_ONLY, inf::INPUT_WINDOW, slots[0].source.data(), verify.bank(0), &err)
+	);
+	add_views(slots[0]);
+	OCL_CHECK(err,
+	    buffer_state   = inf::bank_buffer(context, CL_MEM_READ_WRITE, sizeof(fpga::tinf_state), state.data(), verify.bank(2), &err)
+	);
+	OCL_CHECK(err,
+	    buffer_history = inf::bank_buffer(context, CL_MEM_READ_WRITE, sizeof(fpga::tinf_history), history.data(), verify.bank(3), &err)
+	);
+
+	OCL_CHECK(err, err = kernel_verify.setArg(0, slots[0].buffer_input));
+	OCL_CHECK(err, err = kernel_verify.setArg(2, buffer_state  ));
+	OCL_CHECK(err, err = kernel_verify.setArg(3, buffer_history));
+#else
+	host = true;
+	(void) context;
+	(void) device;
+	(void) program;
+	(void) verify;
+#endif
+
+	reset();
+}
+
+#ifndef INF_LOCAL_STREAM
+void inf::cu_buffers::add_views(inf::pipeline_slot &slot)
+{
+	cl_int err;
+
+	//Views from the begin of the window, the last one covers all of it
+	for(unsigned int end = inf::VIEW_SIZE; end < inf::INPUT_WINDOW + inf::VIEW_SIZE; end += inf::VIEW_SIZE)
 	{
-		std::cerr << "process #" << omp_get_thread_num() << " exited with error code " << err << "\n";
-		ret = err;
+		_cl_buffer_region region{0, min(end, inf::INPUT_WINDOW)};
+		OCL_CHECK(err,
+		    slot.views.push_back(slot.buffer_input.createSubBuffer(CL_MEM_READ_ONLY, CL_BUFFER_CREATE_TYPE_REGION, &region, &err))
+		);
 	}
+}
+#endif
+
+inf::cu_buffers::cu_buffers(unsigned int depth)
+  : slots(depth), state(1), history(1), has_stream(false), host(true)
+{
+	reset();
+}
 
-	if(parser.exists("N")) std::filesystem::last_write_time(output_file, timestamp);
+void inf::cu_buffers::reset()
+{
+	state[0]   = fpga::tinf_state();
+	history[0] = fpga::tinf_history();
+
+	for(size_t i = 0; i < slots.size(); ++i)
+	{
+		slots[i].length = 0;
+		slots[i].busy   = false;
+	}
 }
-	return ret;
+
+inf::buffer_pool::buffer_pool(cl::Context &context, cl::Device &device, cl::Program &program,
+                              const inf::cu_table &table, const std::string &kernel, unsigned int units, size_t budget)
+  : context(context), device(device), program(program), table(table), kernel(kernel), arenas(units)
+{
+	pairs = inf::buffer_pool::pairs_for(units, budget);
+}
+
+void inf::buffer_pool::set_budget(size_t budget)
+{
+	pairs = inf::buffer_pool::pairs_for(arenas.size(), budget);
+}
+
+unsigned int inf::buffer_pool::pairs_for(unsigned int units, size_t budget)
+{
+	size_t pair_size = inf::INPUT_WINDOW + inf::OUTPUT_CHUNK;
+	size_t per_unit  = budget / (units > 0 ? units : 1);
+
+	unsigned int pairs = per_unit / pair_size < inf::PIPELINE_DEPTH ? per_unit / pair_size : inf::PIPELINE_DEPTH;
+	if(pairs == 0) pairs = 1;
+
+	return pairs;
+}
+
+inf::cu_buffers &inf::buffer_pool::acquire(unsigned int unit)
+{
+	if(!arenas[unit] && kernel == "fpga_verify")
+	{
+		arenas[unit].reset(new inf::cu_buffers(context, device, program, table.unit(kernel, unit)));
+	}
+	else if(!arenas[unit])
+	{
+		arenas[unit].reset(new inf::cu_buffers(context, device, program, table.unit("fpga_uncompress", unit),
+		                                       table.unit("fpga_uncompress_stream", unit), pairs));
+	}
+	else              arenas[unit]->reset();
+
+	return *arenas[unit];
+}
+
+inf::device_registry::device_registry(const std::string &binary_file, const std::string &kernel, unsigned int units, size_t budget)
+{
+	inf::cu_table table;
+
+#ifdef INF_LOCAL_STREAM
+	//Fake cards, the compute units call the kernel model
+	const char *count = getenv("INF_LOCAL_DEVICES");
+	int cards = count != NULL && atoi(count) > 0 ? atoi(count) : 1;
+
+	for(int i = 0; i < cards; ++i) devices.emplace_back(new inf::device_entry());
+
+	//The binary is not loaded, only its compute units are listed
+	struct stat binary_stat;
+	if(stat(binary_file.c_str(), &binary_stat) == 0)
+	{
+	    unsigned fileBufSize;
+	    char* fileBuf = inf::read_binary_file(binary_file, fileBufSize);
+	    table.load(binary_file, fileBuf, fileBufSize);
+	    delete[] fileBuf;
+	}
+#else
+	std::vector<cl::Device> all = inf::get_devices();
+	if(all.empty())
+	{
+		std::cerr << "no accelerator card found\n";
+		return;
+	}
+
+	inf::Stream::init(all[0].getInfo<CL_DEVICE_PLATFORM>());
+    unsigned fileBufSize;
+    char* fileBuf = inf::read_binary_file(binary_file, fileBufSize);
+    cl::Program::Binaries bins{{fileBuf, fileBufSize}};
+    table.load(binary_file, fileBuf, fileBufSize);
+
+	//Program all cards at the same time, a card that fails is left out
+	std::vector<std::unique_ptr<inf::device_entry>> loaded(all.size());
+	std::vector<std::thread> loaders;
+
+	for(size_t i = 0; i < all.size(); ++i)
+	{
+		loaders.emplace_back([&, i]()
+		{
+			cl_int err;
+			std::unique_ptr<inf::device_entry> card(new inf::device_entry());
+			std::vector<cl::Device> device(1, all[i]);
+
+			card->device = all[i];
+			OCL_CHECK(err, card->context = cl::Context(all[i], NULL, NULL, NULL, &err));
+			if(err != CL_SUCCESS) return;
+			OCL_CHECK(err, card->program = cl::Program(card->context, device, bins, NULL, &err));
+			if(err != CL_SUCCESS) return;
+
+			loaded[i] = std::move(card);
+		});
+	}
+	for(size_t i = 0; i < loaders.size(); ++i) loaders[i].join();
+	delete[] fileBuf;
+
+	for(size_t i = 0; i < loaded.size(); ++i)
+	{
+		if(loaded[i]) devices.push_back(std::move(loaded[i]));
+		else          std::cerr << "unable to program card #" << i << "\n";
+	}
+#endif
+
+	//One worker per compute unit of the kernel, as many as threads for binaries without a list
+	if(table.count(kernel) > 0) units = table.count(kernel);
+	else std::cerr << "no compute units of " << kernel << " listed in " << binary_file << ", assuming " << units << "\n";
+
+	for(size_t i = 0; i < devices.size(); ++i)
+	{
+		inf::device_entry &card = *devices[i];
+		card.table = table;
+		card.units = units;
+		card.pool.reset(new inf::buffer_pool(card.context, card.device, card.program, card.table, kernel, units, budget / devices.size()));
+	}
+}
+
+unsigned int inf::device_registry::workers() const
+{
+	unsigned int sum = 0;
+	for(size_t i = 0; i < devices.size(); ++i) sum += devices[i]->units;
+
+	return sum;
+}
+
+inf::device_entry &inf::device_registry::device(unsigned int worker)
+{
+	size_t i = 0;
+	while(worker >= devices[i]->units) worker -= devices[i++]->units;
+
+	return *devices[i];
+}
+
+void inf::device_registry::set_budget(size_t budget)
+{
+	for(size_t i = 0; i < devices.size(); ++i) devices[i]->pool->set_budget(budget / devices.size());
+}
+
+unsigned int inf::device_registry::unit(unsigned int worker)
+{
+	size_t i = 0;
+	while(worker >= devices[i]->units) worker -= devices[i++]->units;
+
+	return worker;
+}
+
+cl::Buffer inf::bank_buffer(cl::Context &context, cl_mem_flags flags, size_t size, void *host, int bank, cl_int *err)
+{
+	if(bank < 0) return cl::Buffer(context, CL_MEM_USE_HOST_PTR | flags, cl::size_type(size), host, err);
+
+	cl_mem_ext_ptr_t ext;
+	ext.flags = XCL_MEM_TOPOLOGY | (unsigned int)(bank);
+	ext.obj   = host;
+	ext.param = 0;
+
+	return cl::Buffer(context, CL_MEM_USE_HOST_PTR | CL_MEM_EXT_PTR_XILINX | flags, cl::size_type(size), &ext, err);
+}
+
+bool inf::open_stream_kernel(cl::Program &program, const std::string &kernel_name, cl::Kernel &kernel)
+{
+#ifdef INF_LOCAL_STREAM
+	//The buffer kernel model can be selected for testing of its pipeline
+	(void) program;
+	(void) kernel_name;
+	(void) kernel;
+	return getenv("INF_BUFFER_KERNEL") == NULL;
+#else
+	cl_int err;
+
+	if(!inf::Stream::available()) return false;
+
+	kernel = cl::Kernel(program, kernel_name.c_str(), &err);
+
+	return err == CL_SUCCESS;
+#endif
+}
+
+void inf::stream_write(inf::stream_port &port, const unsigned char *data, unsigned int length, bool eot)
+{
+#ifdef INF_LOCAL_STREAM
+	for(unsigned int i = 0; i < length; i += 8)
+	{
+		fpga::packet p;
+		unsigned int n = min(8, length - i);
+
+		p.data = 0;
+		for(unsigned int j = 0; j < n; ++j) p.data |= (unsigned long long) data[i + j] << (8 * j);
+		p.keep = (1U << n) - 1;
+		p.last = eot && i + 8 >= length;
+
+		port.local->write(p);
+	}
+#else
+	cl_int err;
+	cl_stream_xfer_req req{};
+
+	req.flags = eot ? CL_STREAM_EOT : 0;
+	OCL_CHECK(err, inf::Stream::writeStream(port.stream, data, length, &req, &err));
+#endif
+}
+
+unsigned int inf::stream_read(inf::stream_port &port, unsigned char *data, unsigned int length)
+{
+#ifdef INF_LOCAL_STREAM
+	unsigned int n = 0;
+	fpga::packet p;
+
+	do
+	{
+		p = port.local->read();
+		for(unsigned int j = 0; j < 8 && n < length; ++j) data[n++] = (unsigned char) (p.data >> (8 * j));
+	} while(!p.last);
+
+	return n;
+#else
+	cl_int err;
+	cl_stream_xfer_req req{};
+	cl_streams_poll_req_completions done{};
+	cl_int num = 0;
+
+	req.flags = CL_STREAM_EOT | CL_STREAM_NONBLOCKING;
+	OCL_CHECK(err, inf::Stream::readStream(port.stream, data, length, &req, &err));
+	if(err != CL_SUCCESS) return 0;
+
+	//The read completes with TLAST at the end of a segment
+	while(num == 0)
+	{
+		OCL_CHECK(err, inf::Stream::pollStreams(port.device, &done, 1, 1, &num, 1000, &err));
+		if(err != CL_SUCCESS) return 0;
+	}
+
+	return done.nbytes;
+#endif
+}
+
+void inf::write_output(const unsigned char *data, size_t length, FILE *fout, bool to_stdout)
+{
+	if(to_stdout)
+	{
+		//Large writes straight to the descriptor, after the text buffered so far
+		std::cout.flush();
+		fflush(stdout);
+		while(length > 0)
+		{
+			ssize_t n = write(STDOUT_FILENO, data, length);
+			if(n < 0 && errno == EINTR) continue;
+			if(n <= 0) break;
+
+			data   += n;
+			length -= n;
+		}
+	}
+	else
+	{
+		fwrite(data, 1, length, fout);
+	}
 }
 
 unsigned int inf::read_le16(const unsigned char *p)
@@ -411,6 +1423,12 @@ unsigned int inf::min(unsigned int first, unsigned int second)
 	else return first;
 }
 
+unsigned int inf::min(unsigned int first, uint64_t second)
+{
+	if(first > second) return second;
+	else return first;
+}
+
 int inf::check_gzip_header(unsigned char *src, unsigned int sourceLen, unsigned int &time, unsigned int &dist, std::string &filename)
 {
 	unsigned char flg;
@@ -490,7 +1508,7 @@ int inf::check_gzip_header(unsigned char *src, unsigned int sourceLen, unsigned
 
 		hcrc = read_le16(start);
 
-		if (hcrc != (crc32(src, start - src) & 0x0000FFFF)) return inf::TINF_DATA_ERROR;
+		if (hcrc != (inf::crc32(src, start - src) & 0x0000FFFF)) return inf::TINF_DATA_ERROR;
 
 		start += 2;
 	}
@@ -533,10 +1551,10 @@ std::vector<cl::Device> inf::get_devices()
 
 char* inf::read_binary_file(const std::string &xclbin_file_name, unsigned &nb)
 {
-    std::cout << "INFO: Reading " << xclbin_file_name << std::endl;
+    std::cerr << "INFO: Reading " << xclbin_file_name << std::endl;
     
     //Loading XCL Bin into char buffer
-    std::cout << "Loading: '" << xclbin_file_name.c_str() << "'\n";
+    std::cerr << "Loading: '" << xclbin_file_name.c_str() << "'\n";
     std::ifstream bin_file(xclbin_file_name.c_str(), std::ifstream::binary);
     bin_file.seekg(0, bin_file.end);
     nb = bin_file.tellg();
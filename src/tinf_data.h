@@ -8,7 +8,9 @@
 #define CL_USE_DEPRECATED_OPENCL_1_2_APIS
 
 #include <assert.h>
+#include <errno.h>
 #include <limits.h>
+#include <stdint.h>
 #include <omp.h>
 #include <CL/cl2.hpp>
 #include <iostream>
@@ -16,11 +18,26 @@
 #include <CL/cl_ext_xilinx.h>
 #include <sys/stat.h>
 #include <unistd.h>
-#include "./argparse.h"
-using namespace argparse;
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <experimental/filesystem>
+#include "./crc32.h"
+#include "./cu_table.h"
+#include "./io_engine.h"
+#include "./job_scheduler.h"
+#include "./mapped_file.h"
+#include "./fpga_data.h"
+
+namespace std {
+namespace filesystem = std::experimental::filesystem;
+}
 
 /***************************************************************//**
-* Executes an OpenCL command and prints the error if not succeeded.
+* Executes an OpenCL command and prints the error on standard error
+* if not succeeded, standard output may carry the decompressed data.
 * Does not work if call has templatized function call.
 * Unset OCL_CHECK to turn off debugging.
 *
@@ -30,11 +47,39 @@ using namespace argparse;
 #define OCL_CHECK(error,call)                                       \
     call;                                                           \
     if (error != CL_SUCCESS) {                                      \
-      printf("%s:%d Error calling " #call ", error code is: %d\n",  \
-              __FILE__,__LINE__, error);                            \
+      fprintf(stderr, "%s:%d Error calling " #call                  \
+              ", error code is: %d\n", __FILE__,__LINE__, error);   \
     }                                       
 
 namespace inf {
+
+class backend;
+
+/***************************************************************//**
+* \brief Options of the decompression, the command line option of
+* every field is given in brackets
+********************************************************************/
+struct options {
+    options() : binary("../binary_container_1.xclbin"), memory(SIZE_MAX), suffix(".gz"), backend("auto"),
+                to_stdout(false), force(false), keep(false), list(false), no_name(false),
+                name(false), quiet(false), test(false), verbose(false), listing(NULL) {}
+
+    std::string binary;  /**< path to the device binary (-b) */
+    size_t memory;       /**< memory budget of the kernel buffers in bytes (-m) */
+    std::string suffix;  /**< suffix of compressed files (-S) */
+    std::string backend; /**< "fpga", "cpu", "hybrid" or "auto", see open_backend (-B) */
+    std::string socket;  /**< socket of the daemon (-D, -C) */
+    bool to_stdout;      /**< write on standard output, keep input files (-c) */
+    bool force;          /**< overwrite existing output files (-f) */
+    bool keep;           /**< keep input files (-k) */
+    bool list;           /**< list compressed file contents (-l) */
+    bool no_name;        /**< ignore the original name of the header (-n) */
+    bool name;           /**< restore the original time stamp (-N) */
+    bool quiet;          /**< suppress all messages (-q) */
+    bool test;           /**< test compressed file integrity (-t) */
+    bool verbose;        /**< print the throughput of every file (-v) */
+    std::ostream *listing; /**< stream the contents are listed on with list, e.g. std::cout, NULL for none */
+};
   
 /***************************************************************//**
 * Custom allocator to ensure that vectors are page-aligned
@@ -52,6 +97,7 @@ struct aligned_allocator
   }
   void deallocate(T* p, std::size_t num)
   {
+    (void) num;
     free(p);
   }
 };
@@ -76,13 +122,304 @@ class Stream
         bar = clGetExtensionFunctionAddressForPlatform(platform, "clPollStreams");
         pollStreams = (decltype(&clPollStreams))bar;
     }
+    /***************************************************************//**
+    * \brief Returns true if the platform provides all stream functions
+    ********************************************************************/
+    static bool available() {
+        return createStream && releaseStream && readStream && writeStream && pollStreams;
+    }
+};
+
+/***************************************************************//**
+* End of a host stream connected to a streaming kernel. For CPU-only
+* testing, compile the host with INF_LOCAL_STREAM and link
+* fpga_data.cpp: the kernel model then runs in a thread behind local
+* FIFOs instead of device streams.
+********************************************************************/
+struct stream_port {
+#ifdef INF_LOCAL_STREAM
+    fpga::stream<fpga::packet, fpga::TINF_WORD_DEPTH> *local; /**< local stand-in of the device stream */
+#else
+    cl_stream stream;    /**< device stream */
+    cl_device_id device; /**< device the stream belongs to, for polling */
+#endif
+};
+
+/***************************************************************//**
+* Size of the output buffer of a kernel run in bytes. The kernel
+* keeps the history window itself, so the buffer is reused for every
+* run and memory per file does not depend on the file size.
+********************************************************************/
+static const unsigned int OUTPUT_CHUNK = 4 << 20;
+
+/***************************************************************//**
+* Size of the input window of a kernel run in bytes. A multiple of 8,
+* such that every window pushed to a streaming kernel consists of
+* whole words.
+********************************************************************/
+static const unsigned int INPUT_WINDOW = 100000;
+
+/***************************************************************//**
+* Number of input/output buffer pairs per compute unit of the buffer
+* kernel. Three pairs let the file read of the next window, the
+* kernel run and the output write of the last run overlap.
+********************************************************************/
+static const unsigned int PIPELINE_DEPTH = 3;
+
+/***************************************************************//**
+* Length of a deflate stream that is read until the end of its file,
+* e.g. from a pipe, see inflate_buffer
+********************************************************************/
+static const uint64_t UNKNOWN_LENGTH = UINT64_MAX;
+
+/***************************************************************//**
+* Granularity of the sub-buffer views of an input window in bytes,
+* a multiple of the page size. A run migrates the smallest view that
+* covers its window.
+********************************************************************/
+static const unsigned int VIEW_SIZE = 4096;
+
+/***************************************************************//**
+* Input/output buffer pair of the buffer kernel pipeline
+********************************************************************/
+struct pipeline_slot {
+    pipeline_slot() : source(INPUT_WINDOW), dest(OUTPUT_CHUNK), length(0), busy(false) {}
+
+    std::vector<unsigned char,aligned_allocator<unsigned char>> source; /**< input window */
+    std::vector<unsigned char,aligned_allocator<unsigned char>> dest;   /**< output of a run */
+#ifndef INF_LOCAL_STREAM
+    cl::Buffer buffer_input;        /**< device buffer of source */
+    cl::Buffer buffer_output;       /**< device buffer of dest */
+    std::vector<cl::Buffer> views;  /**< sub-buffers of buffer_input, views[i] covers (i + 1) * VIEW_SIZE bytes */
+    cl::Event done;                 /**< completes when dest holds the output */
+#endif
+    unsigned int length; /**< number of output bytes in dest */
+    bool busy;           /**< true until the output has been written */
+};
+
+/***************************************************************//**
+* \brief Buffers, command queue and kernels of a compute unit.
+*
+* Everything is created once, registered with the device, and
+* reused for every file the compute unit inflates. Only the thread
+* that owns the compute unit may use it.
+********************************************************************/
+struct cu_buffers {
+    /***************************************************************//**
+    * \brief Creates the buffers and kernels of a compute unit with
+    * depth buffer pairs. The buffers are placed in the memory banks
+    * the arguments of inflate are connected to.
+    *
+    * @param inflate compute unit of fpga_uncompress
+    * @param stream compute unit of fpga_uncompress_stream
+    ********************************************************************/
+    cu_buffers(cl::Context &context, cl::Device &device, cl::Program &program,
+               const compute_unit &inflate, const compute_unit &stream, unsigned int depth);
+
+    /***************************************************************//**
+    * \brief Creates the command queue, kernel and buffers of a compute
+    * unit of the verify kernel: one input window without output, see
+    * verify_buffer. The buffers are placed in the memory banks the
+    * arguments of verify are connected to.
+    *
+    * @param verify compute unit of fpga_verify
+    ********************************************************************/
+    cu_buffers(cl::Context &context, cl::Device &device, cl::Program &program, const compute_unit &verify);
+
+    /***************************************************************//**
+    * \brief Creates the buffers of a compute unit on the host, which
+    * runs the kernel code on host memory, see cpu_backend
+    ********************************************************************/
+    explicit cu_buffers(unsigned int depth);
+
+    /***************************************************************//**
+    * \brief Resets state and history for the next file and marks all
+    * buffer pairs free
+    ********************************************************************/
+    void reset();
+
+    std::vector<pipeline_slot> slots; /**< buffer pairs of the pipeline */
+    std::vector<fpga::tinf_state,aligned_allocator<fpga::tinf_state>> state;
+    std::vector<fpga::tinf_history,aligned_allocator<fpga::tinf_history>> history;
+    bool has_stream;          /**< true if kernel_stream can be used */
+    bool host;                /**< true if the kernel code runs on the host instead of a device */
+    cl::Kernel kernel_stream; /**< compute unit of fpga_uncompress_stream */
+#ifndef INF_LOCAL_STREAM
+    cl::Device device;
+    cl::CommandQueue q;       /**< out-of-order queue, commands are ordered by events */
+    cl::Kernel kernel_inflate;
+    cl::Kernel kernel_verify; /**< compute unit of fpga_verify, for buffers of the verify kernel */
+    cl::Buffer buffer_state;
+    cl::Buffer buffer_history;
+
+  private:
+    /***************************************************************//**
+    * \brief Creates the views of the input buffer of a buffer pair
+    ********************************************************************/
+    static void add_views(pipeline_slot &slot);
+#endif
+};
+
+/***************************************************************//**
+* \brief Pool of the buffers of all compute units within a memory
+* budget.
+*
+* The buffers of a compute unit are created when it is acquired for
+* the first time and recycled for every following file, so the setup
+* cost is paid once per compute unit and not once per file. The
+* budget limits the host and device memory of all buffer pairs; it
+* sets the number of buffer pairs per compute unit between 1 and
+* PIPELINE_DEPTH.
+********************************************************************/
+class buffer_pool
+{
+  public:
+    /***************************************************************//**
+    * @param context OpenCL context of the device
+    * @param device device the kernels run on
+    * @param program program of the device binary
+    * @param table compute units of the device binary
+    * @param kernel fpga_uncompress, or fpga_verify for buffers of the
+    *        verify kernel
+    * @param units number of compute units
+    * @param budget memory budget in bytes
+    ********************************************************************/
+    buffer_pool(cl::Context &context, cl::Device &device, cl::Program &program,
+                const cu_table &table, const std::string &kernel, unsigned int units, size_t budget);
+
+    /***************************************************************//**
+    * \brief Returns the buffers of compute unit unit (counted from 0),
+    * reset for the next file
+    ********************************************************************/
+    cu_buffers &acquire(unsigned int unit);
+
+    /***************************************************************//**
+    * \brief Returns the number of buffer pairs per compute unit
+    ********************************************************************/
+    unsigned int depth() const { return pairs; }
+
+    /***************************************************************//**
+    * \brief Sets the memory budget in bytes. Compute units acquired
+    * before keep the buffer pairs they have.
+    ********************************************************************/
+    void set_budget(size_t budget);
+
+    /***************************************************************//**
+    * \brief Returns the number of buffer pairs per compute unit for a
+    * number of compute units within a memory budget in bytes
+    ********************************************************************/
+    static unsigned int pairs_for(unsigned int units, size_t budget);
+
+  private:
+    cl::Context &context;
+    cl::Device &device;
+    cl::Program &program;
+    const cu_table &table;
+    std::string kernel;
+    unsigned int pairs;
+    std::vector<std::unique_ptr<cu_buffers>> arenas; /**< by compute unit, created on first use */
+};
+
+/***************************************************************//**
+* Position and checksums of the deflate stream of a gzip file
+********************************************************************/
+struct gzip_member {
+    uint64_t srclen;      /**< size of the gzip file */
+    unsigned int dist;    /**< length of the header */
+    unsigned int crc;     /**< CRC32 of the footer */
+    unsigned int isize;   /**< ISIZE of the footer */
+    unsigned int time;    /**< modification time of the header */
+    std::string filename; /**< original name of the header, may be empty */
+};
+
+/***************************************************************//**
+* An accelerator card with its own context, program and buffer pool
+********************************************************************/
+struct device_entry {
+    cl::Device device;
+    cl::Context context;
+    cl::Program program;
+    cu_table table;                    /**< compute units of the device binary */
+    unsigned int units;                /**< number of compute units */
+    std::unique_ptr<buffer_pool> pool; /**< buffers of the compute units */
+};
+
+/***************************************************************//**
+* \brief Registry of all accelerator cards of the host.
+*
+* The device binary is read once and programmed onto every card in
+* parallel, each card gets a context, a program and a buffer pool of
+* its own. The compute units of a kernel are taken from the cu_table
+* of the binary, so one binary scales from 1 to N compute units
+* without changes of the host. The compute units of all cards are
+* numbered as workers: worker w runs on the compute unit w - first
+* worker of its card, so a job_scheduler over all workers spreads the
+* files across the cards.
+*
+* Built with INF_LOCAL_STREAM, no device is opened: the registry
+* holds INF_LOCAL_DEVICES (environment, default 1) fake cards whose
+* compute units run the kernel model, so several cards can be tested
+* without hardware.
+********************************************************************/
+class device_registry
+{
+  public:
+    /***************************************************************//**
+    * @param binary_file path to the device binary
+    * @param kernel kernel whose compute units become workers
+    * @param units number of compute units per card if the binary has
+    *        no compute unit list
+    * @param budget memory budget in bytes, shared evenly by the cards
+    ********************************************************************/
+    device_registry(const std::string &binary_file, const std::string &kernel, unsigned int units, size_t budget);
+
+    /***************************************************************//**
+    * \brief Returns the number of cards
+    ********************************************************************/
+    size_t size() const { return devices.size(); }
+
+    /***************************************************************//**
+    * \brief Returns the number of compute units of all cards
+    ********************************************************************/
+    unsigned int workers() const;
+
+    /***************************************************************//**
+    * \brief Returns the card of a worker
+    ********************************************************************/
+    device_entry &device(unsigned int worker);
+
+    /***************************************************************//**
+    * \brief Sets the memory budget in bytes, shared evenly by the
+    * cards, before their compute units are acquired
+    ********************************************************************/
+    void set_budget(size_t budget);
+
+    /***************************************************************//**
+    * \brief Returns the compute unit of a worker on its card
+    ********************************************************************/
+    unsigned int unit(unsigned int worker);
+
+  private:
+    std::vector<std::unique_ptr<device_entry>> devices;
+};
+
+/***************************************************************//**
+* Busy time and amount of data of a pipeline stage
+********************************************************************/
+struct stage_stats {
+    double seconds; /**< time the stage was busy */
+    size_t bytes;   /**< bytes passed through the stage */
 };
 
-static const unsigned int tinf_crc32tab[16] = {
-	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190,
-	0x6B6B51F4, 0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344,
-	0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278,
-	0xBDBDF21C
+/***************************************************************//**
+* Throughput of the stages of the buffer kernel pipeline: the read
+* stage counts file input, the kernel stage compressed bytes
+* consumed by the kernel, the write stage output bytes
+********************************************************************/
+struct pipeline_stats {
+    stage_stats read;
+    stage_stats kernel;
+    stage_stats write;
 };
 
 /***************************************************************//**
@@ -135,31 +472,227 @@ unsigned int read_le32(const unsigned char *p);
 unsigned int min(unsigned int first, unsigned int second);
 
 /***************************************************************//**
-* \brief Uncompresses a number of gzip files                       
-*                                                                  
-* Depending on specific options the function decompresses gzip 
-* files possibly in parallel. Output files are created 
-* automatically. The output names also depend on options.
-* 
-* @param input_list contains paths to gzip files (absolute or relative)
-* @param parser the argument parser that contains specific options                            
+* \brief Returns the smaller of both inputs, e.g. of a window and the
+* rest of a stream beyond 4 GiB
+********************************************************************/
+unsigned int min(unsigned int first, uint64_t second);
+
+/***************************************************************//**
+* \brief Uncompresses a gzip file on a unit of a backend
+*
+* Checks header and suffix, creates the output file and inflates the
+* deflate stream on the unit, see backend. Returns a tinf_error_code.
+*
+* @param input_file path to the gzip file (absolute or relative)
+* @param engine backend the file is inflated on
+* @param unit unit of the backend (counted from 0)
+* @param opt options of the decompression
+********************************************************************/
+int uncompress_file(const std::string &input_file, backend &engine, unsigned int unit, const options &opt);
+
+/***************************************************************//**
+* \brief Reads size, header and footer of a gzip file and checks the
+* header. Returns a tinf_error_code.
+*
+* @param *fin gzip file, opened for reading
+* @param member gets overridden with the position of the deflate
+*        stream and the checksums
 ********************************************************************/
-int gzip_uncompress(std::vector<std::string> input_list, ArgumentParser &parser);
+int read_gzip_member(FILE *fin, gzip_member &member);
+
+/***************************************************************//**
+* \brief Inflates the deflate stream of a gzip file with the
+* streaming kernel if cu has one, else with the buffer kernel, and
+* checks CRC32 and ISIZE of the output against the footer. Streams of
+* 4 GiB or more always take the buffer kernel, whose runs read one
+* window each. Returns a tinf_error_code.
+*
+* @param member as read by read_gzip_member
+* @param output_total gets overridden with the number of bytes written
+* @param stats gets overridden with the throughput of the buffer path
+********************************************************************/
+int inflate_member(cu_buffers &cu, FILE *fin, const gzip_member &member, FILE *fout, bool to_stdout,
+                   size_t &output_total, pipeline_stats &stats);
+
+/***************************************************************//**
+* \brief Inflates the deflate stream of a file through the buffer
+* kernel, one input window per kernel run.
+*
+* The runs are pipelined over the buffer pairs of cu: a thread
+* reads the file ahead, another one writes the output of finished
+* runs, and the device commands are ordered by their events. A run
+* waits for the state of the last one only, not for its output.
+* Built with INF_LOCAL_STREAM, the kernel model is called instead.
+*
+* A regular file is not read by a thread but mapped, see mapped_file:
+* every window starts at the first byte the last run left unused and
+* is copied from the mapping into the input buffer, host units run the
+* kernel code on the mapping itself. The outputs of all finished runs
+* are written to a regular file in one batch of the shared io_engine.
+*
+* The function writes the output to fout, or to standard output if
+* to_stdout is set, and updates output_total. The kernel computes the
+* CRC32 and the length of the output, they are returned in crc and
+* isize for the comparison with the gzip footer. Returns a
+* tinf_error_code.
+*
+* With length UNKNOWN_LENGTH the deflate stream is read from the
+* current position of fin until the end of the file, without seeking,
+* so fin may be a pipe. rest then holds the bytes already read from
+* fin ahead of the stream on entry, and the bytes read past its end,
+* starting with the footer, on return.
+*
+* @param cu buffers and kernels of the compute unit, see buffer_pool
+* @param *fin input file
+* @param offset position of the deflate stream in fin
+* @param length length of the deflate stream (without footer)
+* @param *fout output file
+* @param to_stdout write on standard output instead of fout
+* @param crc gets overridden with the CRC32 of the output
+* @param isize gets overridden with the length of the output modulo 2^32
+* @param output_total gets increased by the number of output bytes
+* @param stats gets increased by the busy time and data of each stage
+* @param rest bytes read ahead of and past a stream of UNKNOWN_LENGTH
+********************************************************************/
+int inflate_buffer(cu_buffers &cu, FILE *fin, long offset, uint64_t length, FILE *fout, bool to_stdout,
+                   unsigned int &crc, unsigned int &isize, size_t &output_total,
+                   pipeline_stats &stats, std::vector<unsigned char> *rest = NULL);
+
+/***************************************************************//**
+* \brief Inflates the deflate stream of a file through the streaming
+* kernel in a single kernel run.
+*
+* A thread pushes the input window by window while the output is
+* pulled segment by segment, there is no migration of input or
+* output buffers. Uses kernel_stream, state and history of cu and the
+* output buffer of its first buffer pair. The length of the stream is
+* an argument of the kernel run and must be less than 4 GiB.
+* Parameters and return value as inflate_buffer.
+********************************************************************/
+int inflate_stream(cu_buffers &cu, FILE *fin, long offset, uint64_t length, FILE *fout, bool to_stdout,
+                   unsigned int &crc, unsigned int &isize, size_t &output_total);
+
+/***************************************************************//**
+* \brief Inflates the deflate stream of a file through the verify
+* kernel, one input window per kernel run, and discards the output.
+*
+* A regular file is read from its memory mapping, see mapped_file;
+* otherwise a read stage of its own thread reads the next input
+* windows while the kernel runs, as in inflate_buffer. Returns a
+* tinf_error_code, crc and isize as in inflate_buffer.
+*
+* @param cu buffers and kernel of a compute unit of fpga_verify, see
+*        buffer_pool
+********************************************************************/
+int verify_buffer(cu_buffers &cu, FILE *fin, long offset, uint64_t length,
+                  unsigned int &crc, unsigned int &isize);
+
+/***************************************************************//**
+* \brief Creates a buffer that uses host memory in a memory bank of
+* the device, bank -1 leaves the placement to the runtime
+*
+* @param flags memory flags, CL_MEM_USE_HOST_PTR is added
+* @param size size of the buffer in bytes
+* @param host host memory of the buffer (4 KiB aligned)
+* @param bank memory bank as in the MEM_TOPOLOGY of the binary
+* @param err gets overridden with the error code
+********************************************************************/
+cl::Buffer bank_buffer(cl::Context &context, cl_mem_flags flags, size_t size, void *host, int bank, cl_int *err);
+
+/***************************************************************//**
+* \brief Creates a compute unit of the streaming kernel. Returns
+* false if the platform has no stream support or the device binary
+* does not contain the kernel, the buffer kernel is used then.
+*
+* @param program program of the device binary
+* @param kernel_name name of the compute unit
+* @param kernel gets overridden with the compute unit
+********************************************************************/
+bool open_stream_kernel(cl::Program &program, const std::string &kernel_name, cl::Kernel &kernel);
+
+/***************************************************************//**
+* \brief Pushes length bytes to a streaming kernel, eot marks the
+* last bytes of a run
+********************************************************************/
+void stream_write(stream_port &port, const unsigned char *data, unsigned int length, bool eot);
+
+/***************************************************************//**
+* \brief Pulls a segment of at most length bytes from a streaming
+* kernel and returns its length, 0 on failure
+********************************************************************/
+unsigned int stream_read(stream_port &port, unsigned char *data, unsigned int length);
+
+/***************************************************************//**
+* \brief Writes output to a file or to standard output
+*
+* @param *data pointer to output
+* @param length number of bytes
+* @param *fout output file
+* @param to_stdout write on standard output instead of fout
+********************************************************************/
+void write_output(const unsigned char *data, size_t length, FILE *fout, bool to_stdout);
 
 /***************************************************************//**
 * \brief Performs an integrity check on a number of gzip files     
 *                                                                  
 * Depending on specific options the function performs an integrity 
-* check on the files possibly in parallel. The function returns an 
+* check on the files possibly in parallel. With --test every file is
+* inflated by the verify kernel, which only reports the CRC32 and the
+* length of the output, so no output crosses the bus or reaches the
+* disk. The function returns an 
 * error if at least one thread encounters an error, else TIN_OK. 
 * The function returns TINF_DATA_ERROR if at least one file is not 
 * a valid gzip file, else TINF_OK. The function may encounter an 
 * out-of-memory exception if the headers do not fit into system  memory.   
 * 
 * @param input_list contains paths to gzip files (absolute or relative)
-* @param parser the argument parser that contains specific options        
+* @param opt options of the decompression        
+********************************************************************/
+int check_integrity(std::vector<std::string> input_list, const options &opt);
+
+/***************************************************************//**
+* \brief Uncompresses a gzip stream of unknown length, e.g. standard
+* input, on a unit of a backend, as gunzip does for a pipe.
+*
+* The input is read in windows and never searched, so it may be a
+* pipe. The footer of every member is checked when the end of its
+* deflate stream is reached; concatenated members are uncompressed
+* one after another. Messages go to standard error. Returns a
+* tinf_error_code.
+*
+* @param fin input stream
+* @param fout output stream, written with large unbuffered writes if
+*        it is stdout
+* @param engine backend the stream is inflated on
+* @param unit unit of the backend (counted from 0)
+* @param opt options of the decompression
+********************************************************************/
+int uncompress_pipe(FILE *fin, FILE *fout, backend &engine, unsigned int unit, const options &opt);
+
+/***************************************************************//**
+* \brief Reads and checks a gzip header from a stream that cannot be
+* searched. Returns a tinf_error_code, TINF_DATA_ERROR if the header
+* is invalid or incomplete.
+*
+* @param *fin input stream
+* @param rest bytes read from fin ahead, taken first; the bytes
+*        after the header are left in it
+* @param member gets overridden with time and filename, srclen, crc
+*        and isize stay 0 as they are not known before the end
+********************************************************************/
+int read_stream_header(FILE *fin, std::vector<unsigned char> &rest, gzip_member &member);
+
+/***************************************************************//**
+* \brief Checks or lists a gzip file, see check_integrity. The
+* backend is used with --test only, --list writes a row of the file
+* to opt.listing. Returns a tinf_error_code.
+*
+* @param input_file path to the gzip file (absolute or relative)
+* @param engine backend the file is verified on, NULL for --list
+* @param unit unit of the backend (counted from 0)
+* @param opt options of the decompression
 ********************************************************************/
-int check_integrity(std::vector<std::string> input_list, ArgumentParser &parser);
+int check_file(const std::string &input_file, backend *engine, unsigned int unit, const options &opt);
 
 /***************************************************************//**
 * \brief Performs an integrity check on a gzip file                
@@ -179,17 +712,6 @@ int check_integrity(std::vector<std::string> input_list, ArgumentParser &parser)
 * @param filename gets overridden with original filename if present                 
 ********************************************************************/
 int check_gzip_header(unsigned char *src, unsigned int sourceLen, unsigned int &time, unsigned int &dist, std::string &filename);
-
-/***************************************************************//**
-* Returns a cyclic redundancy checksum of a number of bytes of   
-* given input data as specified in ISO 3309 standard. The function 
-* may encounter a segmentation fault if the number is larger than 
-* the array that contains the data. 
-*
-* @param *data pointer to data
-* @param length number of bytes that should be accounted                   
-********************************************************************/
-unsigned int crc32(const void *data, unsigned int length);
  
 /***************************************************************//**
 * \brief Finds all valid Xilinx devices and stores it in a 
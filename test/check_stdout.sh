@@ -0,0 +1,29 @@
+#!/bin/sh
+# Checks that tinfcpp writes the same bytes as gzip -dc on standard
+# output, for a file given on the command line and for the file piped
+# into standard input.
+#
+# usage: test/check_stdout.sh FILE.gz...
+#
+# TINFCPP is the host binary (default ./tinfcpp), TINF_OPTIONS are
+# added to every call, e.g. "-b binary_container_1.xclbin -B cpu".
+
+TINFCPP=${TINFCPP:-./tinfcpp}
+failed=0
+
+for file in "$@"
+do
+	expected=$(mktemp)
+	actual=$(mktemp)
+	gzip -dc "$file" > "$expected"
+
+	$TINFCPP -c $TINF_OPTIONS "$file" > "$actual"
+	if cmp -s "$expected" "$actual"; then echo "ok     $file"; else echo "FAILED $file"; failed=1; fi
+
+	cat "$file" | $TINFCPP -c $TINF_OPTIONS > "$actual"
+	if cmp -s "$expected" "$actual"; then echo "ok     $file (stdin)"; else echo "FAILED $file (stdin)"; failed=1; fi
+
+	rm -f "$expected" "$actual"
+done
+
+exit $failed
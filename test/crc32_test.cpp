@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "../src/crc32.h"
+
+/***************************************************************//**
+* \brief Tests of the CRC32 of src/crc32.h against a bitwise
+* reference: slice-by-8, the folding with carry-less multiplication
+* if the CPU has PCLMULQDQ, and chained updates.
+*
+* Build and run from the top directory, e.g.
+* g++ -std=c++14 -O2 test/crc32_test.cpp src/crc32.cpp -o crc32_test && ./crc32_test
+* The exit status is EXIT_FAILURE if a check failed.
+********************************************************************/
+
+namespace {
+
+int failed = 0;
+
+void check(bool ok, const std::string &what)
+{
+	printf("%s %s\n", ok ? "ok    " : "FAILED", what.c_str());
+	if(!ok) ++failed;
+}
+
+/***************************************************************//**
+* \brief CRC32 of ISO 3309 one bit at a time, the reference
+********************************************************************/
+unsigned int reference(unsigned int crc, const unsigned char *data, size_t length)
+{
+	unsigned int c = crc ^ 0xFFFFFFFF;
+
+	for(size_t i = 0; i < length; ++i)
+	{
+		c ^= data[i];
+		for(int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+	}
+
+	return c ^ 0xFFFFFFFF;
+}
+
+} //namespace
+
+int main()
+{
+	const char *clmul = inf::crc32_has_clmul() ? "PCLMULQDQ" : "slice-by-8, no PCLMULQDQ";
+
+	//Check value of the standard
+	const unsigned char digits[] = "123456789";
+	check(inf::crc32(digits, 9) == 0xCBF43926 && reference(0, digits, 9) == 0xCBF43926, "check value of \"123456789\"");
+	check(inf::crc32(digits, 0) == 0, "empty input");
+
+	//Pseudo random bytes, the same on every run
+	std::vector<unsigned char> data(1 << 20);
+	unsigned int x = 2463534242U;
+	for(size_t i = 0; i < data.size(); ++i)
+	{
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		data[i] = (unsigned char) x;
+	}
+
+	//Every length up to a few folding blocks, at every alignment
+	bool slice = true;
+	bool update = true;
+	for(size_t offset = 0; offset < 16; ++offset)
+	{
+		for(size_t length = 0; length <= 300; ++length)
+		{
+			unsigned int crc = reference(0, data.data() + offset, length);
+			slice  = slice  && inf::crc32_slice8(0, data.data() + offset, length) == crc;
+			update = update && inf::crc32_update(0, data.data() + offset, length) == crc;
+		}
+	}
+	check(slice,  "slice-by-8, lengths 0 to 300 at 16 alignments");
+	check(update, std::string("crc32_update (") + clmul + "), lengths 0 to 300 at 16 alignments");
+
+	//Long input
+	unsigned int whole = reference(0, data.data(), data.size());
+	check(inf::crc32_slice8(0, data.data(), data.size()) == whole, "slice-by-8 of 1 MiB");
+	check(inf::crc32_update(0, data.data(), data.size()) == whole, std::string("crc32_update (") + clmul + ") of 1 MiB");
+	check(inf::crc32(data.data(), data.size() - 1) == reference(0, data.data(), data.size() - 1), "crc32 of 1 MiB - 1");
+
+	//Chained updates of pieces of any length, starting from the CRC of the last piece
+	unsigned int chained = 0;
+	unsigned int sliced  = 0;
+	for(size_t pos = 0, n = 1; pos < data.size(); pos += n, n = n * 3 % 4099 + 1)
+	{
+		if(n > data.size() - pos) n = data.size() - pos;
+		chained = inf::crc32_update(chained, data.data() + pos, n);
+		sliced  = inf::crc32_slice8(sliced, data.data() + pos, n);
+	}
+	check(chained == whole && sliced == whole, "chained updates of pieces of 1 to 4099 bytes");
+
+	printf("%d failed\n", failed);
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
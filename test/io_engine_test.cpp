@@ -0,0 +1,155 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/io_engine.h"
+
+/***************************************************************//**
+* \brief Tests of inf::io_engine on a temporary file, with io_uring
+* and with the thread pool.
+*
+* Build and run from the top directory, e.g.
+* g++ -std=c++14 -O2 -pthread test/io_engine_test.cpp src/io_engine.cpp -o io_engine_test && ./io_engine_test
+* The exit status is EXIT_FAILURE if a check failed.
+********************************************************************/
+
+namespace {
+
+const size_t BLOCK = 4096;
+const size_t FILE_SIZE = 3 * inf::io_engine::QUEUE_DEPTH * BLOCK + 1000; //Ends within a block
+
+int failed = 0;
+
+void check(bool ok, const char *engine, const std::string &what)
+{
+	printf("%s %-8s %s\n", ok ? "ok    " : "FAILED", engine, what.c_str());
+	if(!ok) ++failed;
+}
+
+/***************************************************************//**
+* \brief Runs all tests on one engine against the file at path
+********************************************************************/
+void test_engine(bool uring, const char *path)
+{
+	inf::io_engine io(uring);
+	const char *name = io.name();
+
+	FILE *file = fopen(path, "w+b");
+	int fd = inf::io_engine::regular_fd(file);
+	check(fd >= 0, name, "descriptor of a regular file");
+	if(fd < 0) return;
+
+	std::vector<unsigned char> data(FILE_SIZE);
+	for(size_t i = 0; i < data.size(); ++i) data[i] = (unsigned char) (i * 2654435761U >> 13);
+
+	//More writes than requests in flight, in one batch
+	std::vector<inf::io_request> writes;
+	for(size_t pos = 0; pos < data.size(); pos += BLOCK)
+	{
+		size_t n = data.size() - pos < BLOCK ? data.size() - pos : BLOCK;
+		writes.push_back(inf::io_request::write(fd, data.data() + pos, n, pos));
+	}
+	check(writes.size() > inf::io_engine::QUEUE_DEPTH, name, "batch deeper than the queue");
+	check(io.run(writes.data(), writes.size()), name, "writes of " + std::to_string(writes.size()) + " blocks");
+
+	bool done = true;
+	for(size_t i = 0; i < writes.size(); ++i) done = done && writes[i].done && writes[i].result == (ssize_t) writes[i].length;
+	check(done, name, "every write done with its whole length");
+
+	//Reads of varying length, submitted and waited for separately
+	std::vector<unsigned char> back(data.size());
+	std::vector<inf::io_request> reads;
+	for(size_t pos = 0, n = 1; pos < back.size(); pos += n, n = n % 7919 + 1013)
+	{
+		if(n > back.size() - pos) n = back.size() - pos;
+		reads.push_back(inf::io_request::read(fd, back.data() + pos, n, pos));
+	}
+	io.submit(reads.data(), reads.size());
+	io.wait(reads.data(), reads.size());
+	check(memcmp(back.data(), data.data(), data.size()) == 0, name, "reads of " + std::to_string(reads.size()) + " ranges");
+
+	//Footer probes: the last 8 bytes, 8 bytes across the end, at the end
+	unsigned char footer[3][8];
+	inf::io_request probes[3] = {
+		inf::io_request::read(fd, footer[0], 8, FILE_SIZE - 8),
+		inf::io_request::read(fd, footer[1], 8, FILE_SIZE - 3),
+		inf::io_request::read(fd, footer[2], 8, FILE_SIZE)
+	};
+	check(!io.run(probes, 3), name, "short reads are reported");
+	check(probes[0].result == 8 && memcmp(footer[0], data.data() + FILE_SIZE - 8, 8) == 0, name, "footer probe");
+	check(probes[1].result == 3 && memcmp(footer[1], data.data() + FILE_SIZE - 3, 3) == 0, name, "short read at the end of the file");
+	check(probes[2].result == 0 && probes[2].done, name, "read at the end of the file");
+
+	//One long read is continued until its whole range is read
+	std::vector<unsigned char> whole(FILE_SIZE + 100);
+	inf::io_request all = inf::io_request::read(fd, whole.data(), whole.size(), 0);
+	io.run(&all, 1);
+	check(all.result == (ssize_t) FILE_SIZE && memcmp(whole.data(), data.data(), FILE_SIZE) == 0, name, "long read up to the end of the file");
+
+	//Requests of several threads at once
+	std::vector<std::thread> threads;
+	std::vector<int> same(16, 0);
+	for(size_t t = 0; t < same.size(); ++t)
+	{
+		threads.emplace_back([&, t]()
+		{
+			std::vector<unsigned char> b(BLOCK * 32);
+			std::vector<inf::io_request> r;
+			for(size_t i = 0; i < 32; ++i) r.push_back(inf::io_request::read(fd, b.data() + i * BLOCK, BLOCK, (t * 32 + i) * BLOCK % (FILE_SIZE - BLOCK)));
+
+			bool ok = io.run(r.data(), r.size());
+			for(size_t i = 0; i < 32; ++i) ok = ok && memcmp(b.data() + i * BLOCK, data.data() + r[i].offset, BLOCK) == 0;
+			same[t] = ok;
+		});
+	}
+	for(size_t t = 0; t < threads.size(); ++t) threads[t].join();
+
+	bool ok = true;
+	for(size_t t = 0; t < same.size(); ++t) ok = ok && same[t];
+	check(ok, name, "reads of " + std::to_string(same.size()) + " threads");
+
+	fclose(file);
+
+	//Errors
+	unsigned char byte;
+	inf::io_request bad = inf::io_request::read(-1, &byte, 1, 0);
+	check(!io.run(&bad, 1) && bad.done && bad.result == -EBADF, name, "read of an invalid descriptor");
+}
+
+} //namespace
+
+int main()
+{
+	const char *dir = getenv("TMPDIR");
+	std::string path = std::string(dir != NULL ? dir : "/tmp") + "/io_engine_test.XXXXXX";
+
+	int fd = mkstemp(&path[0]);
+	if(fd < 0)
+	{
+		fprintf(stderr, "unable to create a temporary file in '%s'\n", path.c_str());
+		return EXIT_FAILURE;
+	}
+	close(fd);
+
+	test_engine(true,  path.c_str());
+	test_engine(false, path.c_str());
+
+	int pipe_fd[2];
+	if(pipe(pipe_fd) == 0)
+	{
+		FILE *piped = fdopen(pipe_fd[0], "rb");
+		check(inf::io_engine::regular_fd(piped) == -1, "", "no descriptor of a pipe");
+		fclose(piped);
+		close(pipe_fd[1]);
+	}
+
+	unlink(path.c_str());
+
+	printf("%d failed\n", failed);
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}